@@ -8,6 +8,7 @@ from flask_socketio import SocketIO, emit
 from flask_cors import CORS
 import json
 import logging
+import zlib
 from datetime import datetime
 import ssl
 
@@ -124,22 +125,54 @@ def login():
         'error': 'Invalid credentials'
     }), 401
 
-@app.route('/api/esp32/data', methods=['POST'])
-def receive_esp32_data():
-    """Receive data from ESP32 and broadcast to dashboards"""
-    try:
-        data = request.get_json()
+def handle_esp32_record(data):
+    """Apply one record forwarded by the ESP32 and broadcast it to dashboards"""
+    msg_type = data.get('type')
+    
+    if msg_type == 'USER_CONNECTED':
+        device_id = data.get('deviceId')
+        username = data.get('username')
+        
+        device_info = {
+            'deviceId': device_id,
+            'username': username,
+            'status': 'online',
+            'connectedAt': datetime.now().isoformat(),
+            'lastSeen': datetime.now().isoformat(),
+            'gps': None,
+            'imu': None
+        }
         
-        if not data:
-            return jsonify({'success': False, 'error': 'No data received'}), 400
+        active_devices[device_id] = device_info
+        
+        if device_id not in device_history:
+            device_history[device_id] = []
         
-        msg_type = data.get('type')
+        logger.info(f'Device registered via ESP32: {username} ({device_id})')
         
-        if msg_type == 'USER_CONNECTED':
-            device_id = data.get('deviceId')
-            username = data.get('username')
+        # Broadcast to all connected dashboards
+        socketio.emit('device_registered', device_info)
+        
+    elif msg_type == 'USER_DISCONNECT':
+        device_id = data.get('deviceId')
+        if device_id in active_devices:
+            active_devices[device_id]['status'] = 'offline'
+            # Remove from list completely to clean up UI
+            del active_devices[device_id]
             
-            device_info = {
+            socketio.emit('device_disconnected', {
+                'deviceId': device_id, 
+                'username': data.get('username')
+            })
+            logger.info(f'Device explicitly disconnected: {device_id}')
+
+    elif msg_type == 'GPS':
+        device_id = data.get('deviceId')
+        username = data.get('username', 'Unknown')
+        
+        # Auto-register device if not exists
+        if device_id not in active_devices:
+            active_devices[device_id] = {
                 'deviceId': device_id,
                 'username': username,
                 'status': 'online',
@@ -148,131 +181,167 @@ def receive_esp32_data():
                 'gps': None,
                 'imu': None
             }
+            device_history[device_id] = []
+            socketio.emit('device_registered', active_devices[device_id])
+            logger.info(f'Auto-registered device: {username} ({device_id})')
+        
+        gps_info = {
+            'lat': data.get('lat'),
+            'lon': data.get('lon'),
+            'alt': data.get('alt'),
+            'speed': data.get('speed'),
+            'accuracy': data.get('accuracy'),
+            'timestamp': data.get('timestamp', datetime.now().isoformat()),
+            'bridgeTs': data.get('bridgeTs')
+        }
+        
+        active_devices[device_id]['gps'] = gps_info
+        active_devices[device_id]['lastSeen'] = datetime.now().isoformat()
+        
+        # Store in history
+        history_entry = {
+            'type': 'GPS',
+            'data': gps_info,
+            'timestamp': datetime.now().isoformat()
+        }
+        device_history[device_id].append(history_entry)
+        
+        if len(device_history[device_id]) > 1000:
+            device_history[device_id] = device_history[device_id][-1000:]
+        
+        # Broadcast to dashboards
+        socketio.emit('gps_update', {
+            'deviceId': device_id,
+            'username': active_devices[device_id]['username'],
+            'gps': gps_info
+        })
             
-            active_devices[device_id] = device_info
-            
-            if device_id not in device_history:
-                device_history[device_id] = []
-            
-            logger.info(f'Device registered via ESP32: {username} ({device_id})')
-            
-            # Broadcast to all connected dashboards
-            socketio.emit('device_registered', device_info)
-            
-        elif msg_type == 'USER_DISCONNECT':
-            device_id = data.get('deviceId')
-            if device_id in active_devices:
-                active_devices[device_id]['status'] = 'offline'
-                # Remove from list completely to clean up UI
-                del active_devices[device_id]
-                
-                socketio.emit('device_disconnected', {
-                    'deviceId': device_id, 
-                    'username': data.get('username')
-                })
-                logger.info(f'Device explicitly disconnected: {device_id}')
-
-        elif msg_type == 'GPS':
-            device_id = data.get('deviceId')
-            username = data.get('username', 'Unknown')
-            
-            # Auto-register device if not exists
-            if device_id not in active_devices:
-                active_devices[device_id] = {
-                    'deviceId': device_id,
-                    'username': username,
-                    'status': 'online',
-                    'connectedAt': datetime.now().isoformat(),
-                    'lastSeen': datetime.now().isoformat(),
-                    'gps': None,
-                    'imu': None
-                }
-                device_history[device_id] = []
-                socketio.emit('device_registered', active_devices[device_id])
-                logger.info(f'Auto-registered device: {username} ({device_id})')
+    elif msg_type == 'IMU':
+        device_id = data.get('deviceId')
+        username = data.get('username', 'Unknown')
+        
+        # Auto-register device if not exists
+        if device_id not in active_devices:
+            active_devices[device_id] = {
+                'deviceId': device_id,
+                'username': username,
+                'status': 'online',
+                'connectedAt': datetime.now().isoformat(),
+                'lastSeen': datetime.now().isoformat(),
+                'gps': None,
+                'imu': None
+            }
+            device_history[device_id] = []
+            socketio.emit('device_registered', active_devices[device_id])
+            logger.info(f'Auto-registered device: {username} ({device_id})')
+        
+        imu_info = {
+            'accel': data.get('accel'),
+            'gyro': data.get('gyro'),
+            'mag': data.get('mag'),
+            'alpha': data.get('alpha'),
+            'beta': data.get('beta'),
+            'gamma': data.get('gamma'),
+            'timestamp': data.get('timestamp', datetime.now().isoformat()),
+            'bridgeTs': data.get('bridgeTs')
+        }
+        
+        active_devices[device_id]['imu'] = imu_info
+        active_devices[device_id]['lastSeen'] = datetime.now().isoformat()
+        
+        # Store in history
+        history_entry = {
+            'type': 'IMU',
+            'data': imu_info,
+            'timestamp': datetime.now().isoformat()
+        }
+        device_history[device_id].append(history_entry)
+        
+        # Broadcast to dashboards
+        socketio.emit('imu_update', {
+            'deviceId': device_id,
+            'username': active_devices[device_id]['username'],
+            'imu': imu_info
+        })
             
-            gps_info = {
+    elif msg_type == 'FUSED':
+        # Smoothed GPS/IMU estimate from the bridge's filter; only for known devices
+        device_id = data.get('deviceId')
+        if device_id in active_devices:
+            fused_info = {
                 'lat': data.get('lat'),
                 'lon': data.get('lon'),
-                'alt': data.get('alt'),
                 'speed': data.get('speed'),
-                'accuracy': data.get('accuracy'),
-                'timestamp': data.get('timestamp', datetime.now().isoformat())
-            }
-            
-            active_devices[device_id]['gps'] = gps_info
-            active_devices[device_id]['lastSeen'] = datetime.now().isoformat()
-            
-            # Store in history
-            history_entry = {
-                'type': 'GPS',
-                'data': gps_info,
-                'timestamp': datetime.now().isoformat()
-            }
-            device_history[device_id].append(history_entry)
-            
-            if len(device_history[device_id]) > 1000:
-                device_history[device_id] = device_history[device_id][-1000:]
-            
-            # Broadcast to dashboards
-            socketio.emit('gps_update', {
-                'deviceId': device_id,
-                'username': active_devices[device_id]['username'],
-                'gps': gps_info
-            })
-                
-        elif msg_type == 'IMU':
-            device_id = data.get('deviceId')
-            username = data.get('username', 'Unknown')
-            
-            # Auto-register device if not exists
-            if device_id not in active_devices:
-                active_devices[device_id] = {
-                    'deviceId': device_id,
-                    'username': username,
-                    'status': 'online',
-                    'connectedAt': datetime.now().isoformat(),
-                    'lastSeen': datetime.now().isoformat(),
-                    'gps': None,
-                    'imu': None
-                }
-                device_history[device_id] = []
-                socketio.emit('device_registered', active_devices[device_id])
-                logger.info(f'Auto-registered device: {username} ({device_id})')
-            
-            imu_info = {
-                'accel': data.get('accel'),
-                'gyro': data.get('gyro'),
-                'mag': data.get('mag'),
-                'alpha': data.get('alpha'),
-                'beta': data.get('beta'),
-                'gamma': data.get('gamma'),
-                'timestamp': data.get('timestamp', datetime.now().isoformat())
+                'heading': data.get('heading'),
+                'posStd': data.get('posStd'),
+                'bridgeTs': data.get('bridgeTs')
             }
             
-            active_devices[device_id]['imu'] = imu_info
+            active_devices[device_id]['fused'] = fused_info
             active_devices[device_id]['lastSeen'] = datetime.now().isoformat()
             
-            # Store in history
-            history_entry = {
-                'type': 'IMU',
-                'data': imu_info,
-                'timestamp': datetime.now().isoformat()
-            }
-            device_history[device_id].append(history_entry)
-            
-            # Broadcast to dashboards
-            socketio.emit('imu_update', {
+            socketio.emit('fused_update', {
                 'deviceId': device_id,
                 'username': active_devices[device_id]['username'],
-                'imu': imu_info
+                'fused': fused_info
             })
-        
-        return jsonify({'success': True, 'message': 'Data received and broadcasted'})
-        
-    except Exception as e:
-        logger.error(f'Error receiving ESP32 data: {str(e)}')
-        return jsonify({'success': False, 'error': str(e)}), 500
+
+    elif msg_type in ('GEOFENCE_ENTER', 'GEOFENCE_EXIT'):
+        # Zone crossing detected on the bridge
+        event = {
+            'deviceId': data.get('deviceId'),
+            'username': data.get('username'),
+            'fenceId': data.get('fenceId'),
+            'event': 'enter' if msg_type == 'GEOFENCE_ENTER' else 'exit',
+            'lat': data.get('lat'),
+            'lon': data.get('lon'),
+            'bridgeTs': data.get('bridgeTs')
+        }
+        logger.info(f"Geofence {event['event']}: {event['username']} fence {event['fenceId']}")
+        socketio.emit('geofence_event', event)
+
+@app.route('/api/esp32/data', methods=['POST'])
+def receive_esp32_data():
+    """Receive data from ESP32 and broadcast to dashboards
+
+    Accepts a single record or a batch (JSON array), optionally sent with
+    Content-Encoding: deflate (zlib stream) by the uplink batcher.
+    """
+    raw = request.get_data()
+    if request.headers.get('Content-Encoding', '').lower() == 'deflate':
+        try:
+            raw = zlib.decompress(raw)
+        except zlib.error as e:
+            logger.warning(f'Bad deflate stream from ESP32: {str(e)}')
+            return jsonify({'success': False, 'error': f'Invalid deflate stream: {str(e)}'}), 400
+    
+    try:
+        data = json.loads(raw) if raw else None
+    except ValueError as e:
+        logger.warning(f'Bad JSON from ESP32: {str(e)}')
+        return jsonify({'success': False, 'error': f'Invalid JSON: {str(e)}'}), 400
+    
+    if not data:
+        return jsonify({'success': False, 'error': 'No data received'}), 400
+    
+    # Records are applied one by one; a bad record is skipped and counted
+    # instead of failing the batch, because the bridge retries any 5xx and
+    # would re-apply the records that already went through
+    records = data if isinstance(data, list) else [data]
+    rejected = 0
+    for record in records:
+        try:
+            handle_esp32_record(record)
+        except Exception as e:
+            rejected += 1
+            logger.error(f'Rejected ESP32 record: {str(e)}')
+    
+    return jsonify({
+        'success': rejected == 0,
+        'message': 'Data received and broadcasted',
+        'count': len(records) - rejected,
+        'rejected': rejected
+    })
 
 # WebSocket Events
 @socketio.on('connect')
@@ -0,0 +1,39 @@
+#ifndef CHUNK_STAGE_H
+#define CHUNK_STAGE_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Carry-over for the chunked JSON endpoints. ESPAsyncWebServer asks for a
+// chunk of at most maxLen bytes (whatever the TCP window allows, sometimes
+// only a few bytes) and takes a return of 0 as end of stream. Each JSON
+// piece is therefore rendered whole into `piece` and copied out as far as
+// the chunk allows; the rest leads the next chunk. A fill callback built on
+// this always makes progress and returns 0 only after its footer went out.
+struct ChunkStage
+{
+    char piece[192]; // Longest piece any endpoint renders, plus terminator
+    uint16_t len = 0;
+    uint16_t sent = 0;
+
+    void format(const char *fmt, ...)
+    {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(piece, sizeof(piece), fmt, args);
+        va_end(args);
+        len = n < 0 ? 0 : min((size_t)n, sizeof(piece) - 1);
+        sent = 0;
+    }
+
+    // Copy what fits of the unsent part; returns bytes written
+    size_t drain(char *out, size_t room)
+    {
+        size_t n = min((size_t)(len - sent), room);
+        memcpy(out, piece + sent, n);
+        sent += n;
+        return n;
+    }
+};
+
+#endif
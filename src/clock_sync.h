@@ -0,0 +1,60 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <Arduino.h>
+
+// NTP-style clock offset estimator for one phone session.
+// The bridge sends TIME_PING {t0} stamped with its own millis(), the phone
+// answers TIME_PONG {t0, t1} where t1 is its Date.now(), and t3 is the bridge
+// millis() when the pong arrives. Phone clocks drift by seconds, so every
+// sample timestamp is mapped back into the bridge timebase before forwarding.
+struct ClockSync
+{
+    int64_t offset = 0;           // phone clock minus bridge clock (ms, smoothed)
+    uint32_t rtt = 0;             // round trip time (ms, smoothed)
+    uint32_t minRtt = UINT32_MAX; // best round trip seen, used to reject slow samples
+    uint16_t samples = 0;         // accepted samples
+    uint8_t rejected = 0;         // consecutive rejected samples
+    unsigned long lastPing = 0;
+
+    bool synced() const { return samples > 0; }
+
+    void addSample(uint32_t t0, int64_t t1, uint32_t t3)
+    {
+        uint32_t sampleRtt = t3 - t0;
+        // Assume the path is symmetric: the phone read its clock half way through the round trip
+        int64_t sampleOffset = t1 - ((int64_t)t0 + sampleRtt / 2);
+
+        // Samples that sat in a queue carry an asymmetric delay, so skip them
+        // unless the link has genuinely got slower (several rejects in a row)
+        if (synced() && sampleRtt > 2 * minRtt + 20 && rejected < 4)
+        {
+            rejected++;
+            return;
+        }
+        if (rejected >= 4)
+            minRtt = sampleRtt;
+        rejected = 0;
+
+        if (sampleRtt < minRtt)
+            minRtt = sampleRtt;
+
+        if (!synced())
+        {
+            offset = sampleOffset;
+            rtt = sampleRtt;
+        }
+        else
+        {
+            // EWMA with alpha = 1/8
+            offset += (sampleOffset - offset) / 8;
+            rtt = rtt + ((int32_t)sampleRtt - (int32_t)rtt) / 8;
+        }
+        samples++;
+    }
+
+    // Convert a phone Date.now() timestamp into bridge millis()
+    int64_t toBridgeTime(int64_t deviceTs) const { return deviceTs - offset; }
+};
+
+#endif
@@ -12,17 +12,85 @@ const char *HOME_WIFI_SSID = "riyospace";
 const char *HOME_WIFI_PASSWORD = "02242005";
 
 // ====== Flask Server Configuration ======
-// Change this to your laptop's IP address
+// Change this to your laptop's IP address and port
 // Find it by running 'ipconfig' in Windows (look for IPv4 Address)
-const char *FLASK_SERVER_IP = "10.242.232.87";
-const int FLASK_SERVER_PORT = 5000;
+// Add more servers to spread batches across them and fail over when one is down
+const char *const FLASK_SERVERS[] = {
+    "10.242.232.87:5000",
+};
+const size_t FLASK_SERVER_COUNT = sizeof(FLASK_SERVERS) / sizeof(FLASK_SERVERS[0]);
+
+// ====== Uplink Failover Configuration ======
+const uint16_t UPLINK_HTTP_TIMEOUT = 2000;         // Per POST, ms
+const int32_t UPLINK_CONNECT_TIMEOUT = 1000;       // TCP connect, ms; a dead host fails here
+const uint8_t UPLINK_FAILURE_THRESHOLD = 3;        // Failures in a row before a server is skipped
+const uint32_t UPLINK_BACKOFF_MIN = 2000;          // First wait before probing a failed server
+const uint32_t UPLINK_BACKOFF_MAX = 60000;         // Backoff doubles up to this
+const uint8_t UPLINK_MAX_ATTEMPTS = 3;             // Servers a batch is tried on before it is dropped
+
+// ====== Uplink Batching Configuration ======
+const size_t FLASK_QUEUE_SIZE = 10;            // Records held while the uplink catches up
+const size_t UPLINK_BATCH_SIZE = 8;            // Max queued records per POST
+const bool UPLINK_COMPRESSION = true;          // Deflate batches (Content-Encoding: deflate)
+const size_t UPLINK_COMPRESS_MIN_BYTES = 256;  // Small payloads are not worth compressing
 
 // ====== WebSocket Configuration ======
 const int WEBSOCKET_PORT = 80;
 const char *WEBSOCKET_PATH = "/ws";
+const size_t WS_MESSAGE_MAX = 32768; // Largest message reassembled from fragments (a big GEOFENCE_SET)
 
 // ====== Timeout Configuration ======
 const unsigned long DISCONNECT_TIMEOUT = 60000; // 60 seconds
 const unsigned long WIFI_TIMEOUT = 20000;       // 20 seconds for WiFi connection
+const unsigned long RESUME_GRACE_PERIOD = 10000; // Dashboards hear of a dropped phone only after this
+
+// ====== Clock Sync Configuration ======
+const unsigned long CLOCK_SYNC_INTERVAL = 15000;    // Ping each phone every 15 seconds
+const unsigned long CLOCK_SYNC_FAST_INTERVAL = 1000; // Faster pings until the estimate settles
+const uint16_t CLOCK_SYNC_FAST_SAMPLES = 4;
+
+// ====== Adaptive Rate Configuration ======
+const unsigned long RATE_EVAL_INTERVAL = 1000;    // How often the bridge re-evaluates phone send rates
+const unsigned long RATE_LATENCY_TARGET = 500;    // Uplink POST latency (ms) treated as full load
+const size_t RATE_SESSION_BUDGET = 8;             // Sharing sessions treated as full load
+
+// ====== On-device History Configuration ======
+// Per device: HISTORY_GPS_DEPTH * 20 + HISTORY_IMU_DEPTH * 12 bytes (~3.8 KB)
+const size_t HISTORY_MAX_DEVICES = 8;
+const size_t HISTORY_GPS_DEPTH = 150;             // 5 minutes at the default 2 s GPS rate
+const size_t HISTORY_IMU_DEPTH = 60;              // 5 minutes of IMU summaries
+const unsigned long HISTORY_IMU_WINDOW = 5000;    // IMU frames folded into one summary
+
+// ====== Sensor Fusion Configuration ======
+const unsigned long FUSION_OUTPUT_INTERVAL = 1000; // FUSED estimate rate per sharing session
+const unsigned long FUSION_STALE_TIMEOUT = 10000;  // Stop emitting this long after the last GPS fix
+const float FUSION_ACCEL_NOISE = 0.5f;             // Baseline process noise (m/s^2), walking pace
+const float FUSION_IMU_SMOOTHING = 0.2f;           // Low-pass weight of each IMU frame's |a| - g
+const float FUSION_IMU_DEADBAND = 0.3f;            // |a| - g (m/s^2) below this is accelerometer noise
+const float FUSION_ERROR_SMOOTHING = 0.05f;        // Low-pass weight of each fix's prediction error
+const uint32_t FUSION_CYCLE_BUDGET = 4000;         // CPU cycles allowed per filter update
+
+// ====== Geofence Configuration ======
+const size_t GEOFENCE_MAX_FENCES = 512;
+const double GEOFENCE_CELL_DEG = 0.002;            // Index grid cell (~220 m of latitude)
+const size_t GEOFENCE_MAX_CELLS = 64;              // Bigger fences are checked on every fix instead
+const char *GEOFENCE_FILE = "/geofences.json";     // Last fence set pushed, reloaded at boot
+const bool GEOFENCE_UPLINK_EVENTS_ONLY = false;    // Forward only ENTER/EXIT, not GPS or FUSED, while fences are loaded
+
+// ====== Admin Configuration ======
+// Required in admin messages (GEOFENCE_SET, CONFIG_GET/SET) and by /api/config
+// (X-Admin-Token header or "token" parameter); change before deploying.
+// Most values in this file are only defaults: see runtime_config.h for the
+// ones that can be changed at runtime and are kept in NVS.
+const char *ADMIN_TOKEN = "artemis-admin";
+
+// ====== Heap Monitor Configuration ======
+const unsigned long HEAP_SAMPLE_INTERVAL = 60000;  // Log heap health once a minute
+const size_t HEAP_SAMPLE_DEPTH = 120;              // Two hours of samples for the trend and /api/heap
+const uint32_t HEAP_LEAK_WARN_RATE = 4096;         // Free-heap loss per hour (bytes) reported as a leak
+
+// ====== Slow Client Configuration ======
+const size_t CLIENT_BACKLOG_BUDGET = 16384;        // Max bytes held back per WebSocket client
+const unsigned long CLIENT_STALL_TIMEOUT = 15000;  // Disconnect clients stuck with a backlog this long
 
 #endif
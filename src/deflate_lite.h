@@ -0,0 +1,233 @@
+#ifndef DEFLATE_LITE_H
+#define DEFLATE_LITE_H
+
+#include <Arduino.h>
+
+// Minimal zlib (RFC 1950) / DEFLATE (RFC 1951) compressor for uplink batches.
+// Uses a single fixed-Huffman block and greedy LZ77 over a small window, so
+// RAM use is fixed at the hash/chain tables below (about 6 KB) and any
+// standard inflater (Python's zlib, browsers) can decode the output.
+// Telemetry batches repeat the same keys, usernames and deviceIds, which
+// this catches well without the ~300 KB state of a full deflate encoder.
+class DeflateLite
+{
+public:
+    static const uint16_t WINDOW_SIZE = 2048; // Max match distance (power of two)
+    static const uint8_t HASH_BITS = 10;
+    static const uint8_t MAX_CHAIN = 8; // Candidates checked per position
+    static const size_t INPUT_LIMIT = 65535;
+
+    // Compress `in` into `out` as a zlib stream.
+    // Returns the compressed size, or 0 if the input is too large or the
+    // output would not fit in `outCap` (send the batch uncompressed then).
+    size_t compress(const uint8_t *in, size_t len, uint8_t *out, size_t outCap)
+    {
+        if (len > INPUT_LIMIT || outCap < 8)
+            return 0;
+
+        _out = out;
+        _outCap = outCap;
+        _outLen = 0;
+        _bitBuf = 0;
+        _bitCount = 0;
+        memset(_head, 0, sizeof(_head));
+
+        // zlib header: deflate, 32 KB window declared, no dictionary, default level
+        putByte(0x78);
+        putByte(0x01);
+
+        // Single final block with fixed Huffman codes
+        putBits(1, 1);
+        putBits(1, 2);
+
+        size_t pos = 0;
+        while (pos < len)
+        {
+            uint16_t bestLen = 0;
+            uint16_t bestDist = 0;
+
+            if (pos + 3 <= len)
+            {
+                uint16_t h = hash(in + pos);
+                uint16_t candidate = _head[h];
+                uint8_t chain = MAX_CHAIN;
+                size_t maxLen = len - pos < 258 ? len - pos : 258;
+
+                // Positions are stored +1 so 0 means empty
+                while (candidate != 0 && chain-- > 0)
+                {
+                    size_t cpos = candidate - 1;
+                    size_t dist = pos - cpos;
+                    if (dist > WINDOW_SIZE)
+                        break;
+
+                    uint16_t l = 0;
+                    while (l < maxLen && in[cpos + l] == in[pos + l])
+                        l++;
+                    if (l > bestLen)
+                    {
+                        bestLen = l;
+                        bestDist = dist;
+                        if (l == maxLen)
+                            break;
+                    }
+
+                    uint16_t next = _prev[cpos & (WINDOW_SIZE - 1)];
+                    if (next >= candidate)
+                        break; // Slot was overwritten by a newer position
+                    candidate = next;
+                }
+            }
+
+            if (bestLen >= 3)
+            {
+                putLength(bestLen);
+                putDistance(bestDist);
+                for (uint16_t i = 0; i < bestLen; i++, pos++)
+                    insert(in, len, pos);
+            }
+            else
+            {
+                putLiteral(in[pos]);
+                insert(in, len, pos);
+                pos++;
+            }
+
+            if (_outLen + 4 > _outCap)
+                return 0;
+        }
+
+        putHuffman(0, 7); // End of block (symbol 256)
+        if (_bitCount > 0)
+            putByte(_bitBuf & 0xFF);
+
+        uint32_t checksum = adler32(in, len);
+        putByte(checksum >> 24);
+        putByte(checksum >> 16);
+        putByte(checksum >> 8);
+        putByte(checksum);
+
+        return _outLen <= _outCap ? _outLen : 0;
+    }
+
+private:
+    uint16_t _head[1 << HASH_BITS];
+    uint16_t _prev[WINDOW_SIZE];
+
+    uint8_t *_out;
+    size_t _outCap;
+    size_t _outLen;
+    uint32_t _bitBuf;
+    uint8_t _bitCount;
+
+    static uint16_t hash(const uint8_t *p)
+    {
+        uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void insert(const uint8_t *in, size_t len, size_t pos)
+    {
+        if (pos + 3 > len)
+            return;
+        uint16_t h = hash(in + pos);
+        _prev[pos & (WINDOW_SIZE - 1)] = _head[h];
+        _head[h] = pos + 1;
+    }
+
+    void putByte(uint8_t b)
+    {
+        if (_outLen < _outCap)
+            _out[_outLen] = b;
+        _outLen++;
+    }
+
+    // DEFLATE packs bits LSB first
+    void putBits(uint32_t value, uint8_t count)
+    {
+        _bitBuf |= value << _bitCount;
+        _bitCount += count;
+        while (_bitCount >= 8)
+        {
+            putByte(_bitBuf & 0xFF);
+            _bitBuf >>= 8;
+            _bitCount -= 8;
+        }
+    }
+
+    // Huffman codes are defined MSB first, so reverse them into the bit stream
+    void putHuffman(uint16_t code, uint8_t count)
+    {
+        uint16_t reversed = 0;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            reversed = (reversed << 1) | (code & 1);
+            code >>= 1;
+        }
+        putBits(reversed, count);
+    }
+
+    // Fixed Huffman literal/length alphabet (RFC 1951 3.2.6)
+    void putSymbol(uint16_t sym)
+    {
+        if (sym < 144)
+            putHuffman(0x30 + sym, 8);
+        else if (sym < 256)
+            putHuffman(0x190 + sym - 144, 9);
+        else if (sym < 280)
+            putHuffman(sym - 256, 7);
+        else
+            putHuffman(0xC0 + sym - 280, 8);
+    }
+
+    void putLiteral(uint8_t b) { putSymbol(b); }
+
+    void putLength(uint16_t length)
+    {
+        static const uint16_t base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                          35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                          3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        uint8_t i = 28;
+        while (base[i] > length)
+            i--;
+        putSymbol(257 + i);
+        if (extra[i])
+            putBits(length - base[i], extra[i]);
+    }
+
+    void putDistance(uint16_t dist)
+    {
+        static const uint16_t base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                          257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                          8193, 12289, 16385, 24577};
+        static const uint8_t extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                          7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        uint8_t i = 29;
+        while (base[i] > dist)
+            i--;
+        putHuffman(i, 5);
+        if (extra[i])
+            putBits(dist - base[i], extra[i]);
+    }
+
+    static uint32_t adler32(const uint8_t *data, size_t len)
+    {
+        uint32_t a = 1, b = 0;
+        while (len > 0)
+        {
+            size_t chunk = len < 5552 ? len : 5552; // Largest run without overflow
+            len -= chunk;
+            while (chunk--)
+            {
+                a += *data++;
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+};
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef FUSION_H
+#define FUSION_H
+
+#include <Arduino.h>
+
+// Per-session GPS/IMU fusion: a float32 Kalman filter on a constant-velocity
+// model in a local east/north tangent plane around the first fix. In that
+// plane the model is linear, so the EKF reduces to a plain KF, and both axes
+// share one 2x2 covariance (same model, same noise), keeping an update to a
+// few dozen FLOPs on the ESP32 FPU.
+//
+// The phone's IMU frames carry no attitude, so acceleration cannot be
+// rotated into the plane as a control input. Instead each IMU frame runs a
+// predict step, and a sustained deviation of |a| from gravity widens the
+// process noise. The deviation is low-passed and deadbanded first: raw
+// accelerometer noise on a phone lying still would otherwise look like a
+// brisk manoeuvre and undo the smoothing. GPS fixes correct position with
+// their reported accuracy as measurement noise.
+//
+// A constant-velocity model lags in a sustained turn at speed, where the
+// estimate can end up worse than the fixes it is meant to improve. Each fix
+// also measures how good the prediction was: the innovation's mean square is
+// the prediction's plus the fix's, whatever the model got wrong. beatsFix()
+// tells the caller whether the estimate is currently worth sending.
+struct FusionFilter
+{
+    bool initialized = false;
+    double lat0 = 0, lon0 = 0; // Tangent plane origin
+    float metersPerDegLon = 0;
+
+    float px = 0, py = 0; // East / north position, m
+    float vx = 0, vy = 0; // East / north velocity, m/s
+    float p00 = 0, p01 = 0, p11 = 0; // Covariance [pos, vel] shared by both axes
+    float accelVar = FUSION_ACCEL_NOISE * FUSION_ACCEL_NOISE;
+    float accelDev = 0;   // Low-passed |a| - g, m/s^2
+    float fixVar = 0;     // Measurement variance of the last accepted fix, m^2
+    float predictVar = 0; // Low-passed squared error of the prediction at each fix, m^2
+    uint32_t t = 0;       // Bridge millis of the state
+    uint32_t lastFix = 0; // Bridge millis of the last accepted GPS fix
+    uint8_t rejects = 0;  // Consecutive gated-out fixes
+
+    static constexpr float METERS_PER_DEG_LAT = 111320.0f;
+
+    void predict(uint32_t now)
+    {
+        if (!initialized || (int32_t)(now - t) <= 0)
+            return;
+
+        float dt = (now - t) / 1000.0f;
+        if (dt > 10.0f)
+            dt = 10.0f; // Long gaps: cap so covariance does not explode
+
+        px += vx * dt;
+        py += vy * dt;
+
+        // P = F P F' + Q, white-noise acceleration model
+        float dt2 = dt * dt;
+        float q = accelVar;
+        float n00 = p00 + 2 * dt * p01 + dt2 * p11 + q * dt2 * dt2 / 4;
+        float n01 = p01 + dt * p11 + q * dt2 * dt / 2;
+        float n11 = p11 + q * dt2;
+        p00 = n00;
+        p01 = n01;
+        p11 = n11;
+        t = now;
+    }
+
+    // IMU frame: a sustained |a| off 1 g is manoeuvring, and once noise is
+    // filtered and deadbanded out |a_h|^2 = |a|^2 - g^2 ~ 2g(|a| - g)
+    void observeImu(uint32_t now, float accelMag)
+    {
+        accelDev += FUSION_IMU_SMOOTHING * (accelMag - 9.81f - accelDev);
+        float excess = fabsf(accelDev) - FUSION_IMU_DEADBAND;
+        accelVar = FUSION_ACCEL_NOISE * FUSION_ACCEL_NOISE + (excess > 0 ? 2 * 9.81f * excess : 0);
+        predict(now);
+    }
+
+    void observeGps(uint32_t now, double lat, double lon, float accuracy)
+    {
+        if (accuracy < 1.0f)
+            accuracy = 1.0f;
+        float r = accuracy * accuracy;
+
+        float mx, my;
+        if (initialized)
+        {
+            toLocal(lat, lon, mx, my);
+            // Far from the origin (or a stale, drifted state): start over
+            if (fabsf(mx) > 20000.0f || fabsf(my) > 20000.0f || (int32_t)(now - lastFix) > 60000)
+                initialized = false;
+        }
+
+        if (!initialized)
+        {
+            lat0 = lat;
+            lon0 = lon;
+            metersPerDegLon = METERS_PER_DEG_LAT * cosf(lat * DEG_TO_RAD);
+            px = py = vx = vy = 0;
+            p00 = r;
+            p01 = 0;
+            p11 = 4.0f; // (2 m/s)^2 until velocity is observed
+            t = lastFix = now;
+            rejects = 0;
+            fixVar = predictVar = r; // Not worth sending until a prediction beats a fix
+            initialized = true;
+            return;
+        }
+
+        if ((int32_t)(now - t) < 0)
+            return; // Older than the state; clock-corrected frames can arrive out of order
+        predict(now);
+
+        // Gate outliers at ~5 sigma; accept anyway after a few in a row (real jump)
+        float ex = mx - px, ey = my - py;
+        float s = p00 + r;
+        if ((ex * ex + ey * ey) / s > 25.0f && ++rejects < 3)
+            return;
+        rejects = 0;
+
+        // E|innovation|^2 = E|prediction error|^2 + E|fix error|^2, and the
+        // reported accuracy is the fix's radial 1-sigma
+        float e2 = ex * ex + ey * ey;
+        predictVar += FUSION_ERROR_SMOOTHING * (e2 - r - predictVar);
+        fixVar = r;
+
+        // K = P H' / S with H = [1 0]
+        float k0 = p00 / s;
+        float k1 = p01 / s;
+        px += k0 * ex;
+        py += k0 * ey;
+        vx += k1 * ex;
+        vy += k1 * ey;
+
+        float n00 = (1 - k0) * p00;
+        float n01 = (1 - k0) * p01;
+        float n11 = p11 - k1 * p01;
+        p00 = n00;
+        p01 = n01;
+        p11 = n11;
+        lastFix = now;
+    }
+
+    // State extrapolated to `now` without touching the filter
+    void estimate(uint32_t now, double &lat, double &lon, float &ve, float &vn) const
+    {
+        float dt = (int32_t)(now - t) > 0 ? (now - t) / 1000.0f : 0;
+        toGeo(px + vx * dt, py + vy * dt, lat, lon);
+        ve = vx;
+        vn = vy;
+    }
+
+    float positionStd() const { return sqrtf(p00); }
+
+    // Whether the estimate beats the raw fixes. Measured on the prediction
+    // one fix interval ahead, so estimates between fixes, closer to the last
+    // correction, do at least as well.
+    bool beatsFix() const { return initialized && predictVar < fixVar; }
+
+private:
+    void toLocal(double lat, double lon, float &x, float &y) const
+    {
+        x = (float)((lon - lon0) * metersPerDegLon);
+        y = (float)((lat - lat0) * METERS_PER_DEG_LAT);
+    }
+
+    void toGeo(float x, float y, double &lat, double &lon) const
+    {
+        lat = lat0 + y / METERS_PER_DEG_LAT;
+        lon = lon0 + x / metersPerDegLon;
+    }
+};
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef GEOFENCE_H
+#define GEOFENCE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// Edge geofencing: circle and polygon fences in a uniform lat/lon grid, so
+// each fix only tests the fences whose bounding box touches its cell. Cost
+// per fix stays flat as the fence count grows; fences spanning more than
+// GEOFENCE_MAX_CELLS cells go on a short "large" list that every fix checks.
+
+struct Geofence
+{
+    String id;
+    bool circle = false;
+    double lat0 = 0, lon0 = 0; // Circle centre, or polygon bbox min corner
+    float radius = 0;          // Circle radius, m
+    float metersPerDegLon = 0;
+    std::vector<float> points; // Polygon vertices as (dLat, dLon) from lat0/lon0
+    double minLat = 0, minLon = 0, maxLat = 0, maxLon = 0;
+
+    static constexpr float METERS_PER_DEG_LAT = 111320.0f;
+
+    bool contains(double lat, double lon) const
+    {
+        if (lat < minLat || lat > maxLat || lon < minLon || lon > maxLon)
+            return false;
+
+        float dLat = (float)(lat - lat0);
+        float dLon = (float)(lon - lon0);
+
+        if (circle)
+        {
+            float dy = dLat * METERS_PER_DEG_LAT;
+            float dx = dLon * metersPerDegLon;
+            return dx * dx + dy * dy <= radius * radius;
+        }
+
+        // Ray casting along +lon; fences are small enough to treat degrees as planar
+        bool inside = false;
+        size_t n = points.size() / 2;
+        for (size_t i = 0, j = n - 1; i < n; j = i++)
+        {
+            float yi = points[2 * i], xi = points[2 * i + 1];
+            float yj = points[2 * j], xj = points[2 * j + 1];
+            if ((yi > dLat) != (yj > dLat) &&
+                dLon < (xj - xi) * (dLat - yi) / (yj - yi) + xi)
+                inside = !inside;
+        }
+        return inside;
+    }
+};
+
+class GeofenceIndex
+{
+public:
+    size_t size() const { return _fences.size(); }
+    const Geofence &fence(uint16_t i) const { return _fences[i]; }
+
+    void clear()
+    {
+        _fences.clear();
+        _grid.clear();
+        _large.clear();
+    }
+
+    bool addCircle(const String &id, double lat, double lon, float radius)
+    {
+        if (_fences.size() >= GEOFENCE_MAX_FENCES || radius <= 0)
+            return false;
+
+        Geofence f;
+        f.id = id;
+        f.circle = true;
+        f.lat0 = lat;
+        f.lon0 = lon;
+        f.radius = radius;
+        f.metersPerDegLon = Geofence::METERS_PER_DEG_LAT * cosf(lat * DEG_TO_RAD);
+        double dLat = radius / Geofence::METERS_PER_DEG_LAT;
+        double dLon = radius / f.metersPerDegLon;
+        f.minLat = lat - dLat;
+        f.maxLat = lat + dLat;
+        f.minLon = lon - dLon;
+        f.maxLon = lon + dLon;
+        insert(std::move(f));
+        return true;
+    }
+
+    // latLon holds count (lat, lon) pairs
+    bool addPolygon(const String &id, const double *latLon, size_t count)
+    {
+        if (_fences.size() >= GEOFENCE_MAX_FENCES || count < 3)
+            return false;
+
+        Geofence f;
+        f.id = id;
+        f.minLat = f.maxLat = latLon[0];
+        f.minLon = f.maxLon = latLon[1];
+        for (size_t i = 1; i < count; i++)
+        {
+            f.minLat = min(f.minLat, latLon[2 * i]);
+            f.maxLat = max(f.maxLat, latLon[2 * i]);
+            f.minLon = min(f.minLon, latLon[2 * i + 1]);
+            f.maxLon = max(f.maxLon, latLon[2 * i + 1]);
+        }
+        f.lat0 = f.minLat;
+        f.lon0 = f.minLon;
+        f.points.reserve(count * 2);
+        for (size_t i = 0; i < count; i++)
+        {
+            f.points.push_back((float)(latLon[2 * i] - f.lat0));
+            f.points.push_back((float)(latLon[2 * i + 1] - f.lon0));
+        }
+        insert(std::move(f));
+        return true;
+    }
+
+    // Replace all fences from a JSON array of
+    // {"id", "type": "circle", "lat", "lon", "radius"} or
+    // {"id", "type": "polygon", "points": [[lat, lon], ...]}.
+    // Returns the number of fences loaded.
+    size_t loadJson(JsonArrayConst fences)
+    {
+        clear();
+        std::vector<double> latLon;
+        for (JsonObjectConst f : fences)
+        {
+            String id = f["id"] | "";
+            const char *type = f["type"] | "";
+            if (strcmp(type, "circle") == 0)
+            {
+                addCircle(id, f["lat"].as<double>(), f["lon"].as<double>(), f["radius"].as<float>());
+            }
+            else if (strcmp(type, "polygon") == 0)
+            {
+                latLon.clear();
+                for (JsonArrayConst p : f["points"].as<JsonArrayConst>())
+                {
+                    latLon.push_back(p[0].as<double>());
+                    latLon.push_back(p[1].as<double>());
+                }
+                addPolygon(id, latLon.data(), latLon.size() / 2);
+            }
+        }
+        return _fences.size();
+    }
+
+    // Indices of the fences containing the point, ascending
+    void query(double lat, double lon, std::vector<uint16_t> &inside) const
+    {
+        inside.clear();
+        auto cell = _grid.find(cellKey(cellOf(lat), cellOf(lon)));
+        if (cell != _grid.end())
+        {
+            for (uint16_t i : cell->second)
+            {
+                if (_fences[i].contains(lat, lon))
+                    inside.push_back(i);
+            }
+        }
+        for (uint16_t i : _large)
+        {
+            if (_fences[i].contains(lat, lon))
+                inside.push_back(i);
+        }
+        std::sort(inside.begin(), inside.end());
+    }
+
+private:
+    std::vector<Geofence> _fences;
+    std::unordered_map<uint64_t, std::vector<uint16_t>> _grid;
+    std::vector<uint16_t> _large;
+
+    static int32_t cellOf(double deg) { return (int32_t)floor(deg / GEOFENCE_CELL_DEG); }
+    static uint64_t cellKey(int32_t row, int32_t col) { return ((uint64_t)(uint32_t)row << 32) | (uint32_t)col; }
+
+    void insert(Geofence &&f)
+    {
+        uint16_t index = _fences.size();
+        int32_t r0 = cellOf(f.minLat), r1 = cellOf(f.maxLat);
+        int32_t c0 = cellOf(f.minLon), c1 = cellOf(f.maxLon);
+
+        if ((int64_t)(r1 - r0 + 1) * (c1 - c0 + 1) > (int64_t)GEOFENCE_MAX_CELLS)
+        {
+            _large.push_back(index);
+        }
+        else
+        {
+            for (int32_t r = r0; r <= r1; r++)
+                for (int32_t c = c0; c <= c1; c++)
+                    _grid[cellKey(r, c)].push_back(index);
+        }
+        _fences.push_back(std::move(f));
+    }
+};
+
+#endif
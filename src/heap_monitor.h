@@ -0,0 +1,145 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include "chunk_stage.h"
+#include "history_ring.h"
+
+// Long-run heap health. Once per HEAP_SAMPLE_INTERVAL the internal heap is
+// sampled (free, low-water mark, largest free block, live allocations) and
+// logged, and kept in a ring for /api/heap. Fragmentation is estimated as
+// the share of free memory outside the largest free block: 0% means one
+// contiguous region, values near 100% mean plenty free but no big block.
+// A least-squares slope of free bytes over the ring exposes slow leaks
+// that a single snapshot hides.
+struct HeapSample
+{
+    uint32_t t; // millis()
+    uint32_t freeBytes;
+    uint32_t minFree;      // Low-water mark since boot
+    uint32_t largest;      // Largest free block
+    uint32_t allocated;    // Live allocations (blocks)
+    uint8_t fragmentation; // %, see above
+};
+
+class HeapMonitor
+{
+public:
+    HistoryRing<HeapSample, HEAP_SAMPLE_DEPTH> samples = {};
+    float trend = 0;           // Free-heap change, bytes per hour (negative = shrinking)
+    bool leakSuspected = false;
+
+    const HeapSample &latest() const { return samples.at(samples.seq - 1); }
+
+    HeapSample sample(uint32_t now)
+    {
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+
+        HeapSample s;
+        s.t = now;
+        s.freeBytes = info.total_free_bytes;
+        s.minFree = info.minimum_free_bytes;
+        s.largest = info.largest_free_block;
+        s.allocated = info.allocated_blocks;
+        s.fragmentation = s.freeBytes ? 100 - (uint8_t)((uint64_t)s.largest * 100 / s.freeBytes) : 0;
+        samples.push(s);
+
+        updateTrend();
+        return s;
+    }
+
+private:
+    // Fit only once the ring is half full, so boot-time allocations
+    // (WiFi, server, history pool) do not read as a leak
+    void updateTrend()
+    {
+        uint32_t count = samples.seq - samples.oldest();
+        if (count < HEAP_SAMPLE_DEPTH / 2)
+            return;
+
+        // Times relative to the oldest sample keep the sums well inside float range
+        uint32_t t0 = samples.at(samples.oldest()).t;
+        float sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+        for (uint32_t i = samples.oldest(); i < samples.seq; i++)
+        {
+            const HeapSample &s = samples.at(i);
+            float x = (s.t - t0) / 3600000.0f; // Hours
+            float y = s.freeBytes;
+            sumX += x;
+            sumY += y;
+            sumXX += x * x;
+            sumXY += x * y;
+        }
+
+        float denom = count * sumXX - sumX * sumX;
+        if (denom <= 0)
+            return;
+        trend = (count * sumXY - sumX * sumY) / denom;
+        leakSuspected = trend < -(float)HEAP_LEAK_WARN_RATE;
+    }
+};
+
+// Streaming state for one /api/heap response
+struct HeapCursor
+{
+    uint32_t next = 0;
+    uint8_t stage = 0; // 0 header, 1 field names, 2 samples, 3 footer, 4 done
+    bool first = true;
+    ChunkStage out;
+};
+
+// Fill `buffer` with the next piece of the sample ring as JSON; returns 0 when done
+size_t heapFillJson(const HeapMonitor &monitor, HeapCursor &cursor, uint8_t *buffer, size_t maxLen)
+{
+    char *out = (char *)buffer;
+    size_t len = cursor.out.drain(out, maxLen);
+    const auto &ring = monitor.samples;
+
+    while (len < maxLen && cursor.stage < 4)
+    {
+        switch (cursor.stage)
+        {
+        case 0:
+            cursor.out.format("{\"now\":%u,\"trendPerHour\":%.0f,\"leakSuspected\":%s,", (unsigned)millis(),
+                              monitor.trend, monitor.leakSuspected ? "true" : "false");
+            cursor.stage = 1;
+            break;
+
+        case 1:
+            cursor.out.format("\"fields\":[\"t\",\"free\",\"minFree\",\"largest\",\"allocated\",\"fragmentation\"],"
+                              "\"samples\":[");
+            cursor.next = ring.oldest();
+            cursor.stage = 2;
+            break;
+
+        case 2:
+            if (cursor.next >= ring.seq)
+            {
+                cursor.stage = 3;
+                break;
+            }
+            if (cursor.next < ring.oldest())
+                cursor.next = ring.oldest();
+            {
+                const HeapSample &s = ring.at(cursor.next++);
+                cursor.out.format("%s[%u,%u,%u,%u,%u,%u]", cursor.first ? "" : ",", (unsigned)s.t,
+                                  (unsigned)s.freeBytes, (unsigned)s.minFree, (unsigned)s.largest,
+                                  (unsigned)s.allocated, s.fragmentation);
+                cursor.first = false;
+            }
+            break;
+
+        case 3:
+            cursor.out.format("]}");
+            cursor.stage = 4;
+            break;
+        }
+        len += cursor.out.drain(out + len, maxLen - len);
+    }
+
+    return len;
+}
+
+#endif
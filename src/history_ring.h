@@ -0,0 +1,250 @@
+#ifndef HISTORY_RING_H
+#define HISTORY_RING_H
+
+#include <Arduino.h>
+#include "chunk_stage.h"
+
+// Short-term on-device history so a local operator can see recent tracks
+// while the uplink is slow or down. Each device gets a fixed slot holding a
+// ring of compacted GPS points and a ring of IMU summaries (one per
+// HISTORY_IMU_WINDOW), so memory is sizeof(DeviceHistory) per device,
+// known at compile time. The pool lives in PSRAM when the board has it.
+
+// Fixed-size ring addressed by a running sequence number, so a reader can
+// keep a cursor across chunks and detect when the writer has lapped it
+template <typename T, size_t N>
+struct HistoryRing
+{
+    T items[N];
+    uint32_t seq; // Total items ever pushed
+
+    void push(const T &item)
+    {
+        items[seq % N] = item;
+        seq++;
+    }
+
+    uint32_t oldest() const { return seq > N ? seq - N : 0; }
+    const T &at(uint32_t s) const { return items[s % N]; }
+};
+
+struct GpsPoint
+{
+    uint32_t t;        // Bridge millis
+    int32_t lat;       // Degrees * 1e7
+    int32_t lon;       // Degrees * 1e7
+    int16_t alt;       // Meters
+    uint16_t accuracy; // Decimeters
+    uint16_t speed;    // km/h * 100
+};
+
+struct ImuSummary
+{
+    uint32_t t;         // Bridge millis at the start of the window
+    uint16_t count;     // Frames in the window
+    uint16_t accelMean; // |accel| mean, cm/s^2
+    uint16_t accelMax;  // |accel| peak, cm/s^2
+    uint16_t gyroMax;   // |gyro| peak, 0.01 deg/s
+};
+
+struct DeviceHistory
+{
+    char deviceId[40]; // Empty when the slot is free
+    uint32_t lastUpdate;
+    HistoryRing<GpsPoint, HISTORY_GPS_DEPTH> gps;
+    HistoryRing<ImuSummary, HISTORY_IMU_DEPTH> imu;
+
+    // IMU window being accumulated
+    ImuSummary window;
+    float accelSum;
+};
+
+class HistoryStore
+{
+public:
+    static const size_t BYTES = sizeof(DeviceHistory) * HISTORY_MAX_DEVICES;
+
+    bool begin()
+    {
+        _slots = (DeviceHistory *)(psramFound() ? ps_malloc(BYTES) : malloc(BYTES));
+        if (_slots)
+            memset(_slots, 0, BYTES);
+        return _slots != nullptr;
+    }
+
+    bool inPsram() const { return psramFound(); }
+
+    DeviceHistory *find(const char *deviceId)
+    {
+        if (!_slots)
+            return nullptr;
+        for (size_t i = 0; i < HISTORY_MAX_DEVICES; i++)
+        {
+            if (strcmp(_slots[i].deviceId, deviceId) == 0)
+                return &_slots[i];
+        }
+        return nullptr;
+    }
+
+    void addGps(const char *deviceId, uint32_t t, double lat, double lon, float alt, float accuracy, float speed)
+    {
+        DeviceHistory *h = slotFor(deviceId, t);
+        if (!h)
+            return;
+
+        GpsPoint p;
+        p.t = t;
+        p.lat = (int32_t)lround(lat * 1e7);
+        p.lon = (int32_t)lround(lon * 1e7);
+        p.alt = (int16_t)constrain(alt, -32768.0f, 32767.0f);
+        p.accuracy = (uint16_t)constrain(accuracy * 10.0f, 0.0f, 65535.0f);
+        p.speed = (uint16_t)constrain(speed * 100.0f, 0.0f, 65535.0f);
+        h->gps.push(p);
+    }
+
+    void addImu(const char *deviceId, uint32_t t, float accelMag, float gyroMag)
+    {
+        DeviceHistory *h = slotFor(deviceId, t);
+        if (!h)
+            return;
+
+        ImuSummary &w = h->window;
+        if (w.count > 0 && t - w.t >= HISTORY_IMU_WINDOW)
+        {
+            w.accelMean = (uint16_t)constrain(h->accelSum / w.count * 100.0f, 0.0f, 65535.0f);
+            h->imu.push(w);
+            w.count = 0;
+        }
+        if (w.count == 0)
+        {
+            w.t = t;
+            w.accelMax = 0;
+            w.gyroMax = 0;
+            h->accelSum = 0;
+        }
+
+        w.count++;
+        h->accelSum += accelMag;
+        w.accelMax = max(w.accelMax, (uint16_t)constrain(accelMag * 100.0f, 0.0f, 65535.0f));
+        w.gyroMax = max(w.gyroMax, (uint16_t)constrain(gyroMag * 100.0f, 0.0f, 65535.0f));
+    }
+
+private:
+    DeviceHistory *_slots = nullptr;
+
+    // Existing slot for the device, else a free one, else the stalest
+    DeviceHistory *slotFor(const char *deviceId, uint32_t t)
+    {
+        if (!_slots || !deviceId[0])
+            return nullptr;
+
+        DeviceHistory *h = find(deviceId);
+        if (!h)
+        {
+            h = &_slots[0];
+            for (size_t i = 0; i < HISTORY_MAX_DEVICES; i++)
+            {
+                if (!_slots[i].deviceId[0])
+                {
+                    h = &_slots[i];
+                    break;
+                }
+                if (_slots[i].lastUpdate < h->lastUpdate)
+                    h = &_slots[i];
+            }
+            memset(h, 0, sizeof(DeviceHistory));
+            strlcpy(h->deviceId, deviceId, sizeof(h->deviceId));
+        }
+        h->lastUpdate = t;
+        return h;
+    }
+};
+
+// Streaming state for one /api/device/<id>/history response
+struct HistoryCursor
+{
+    String deviceId;
+    uint32_t since;
+    uint32_t next = 0;
+    uint8_t stage = 0; // 0 header, 1 gps, 2 separator, 3 imu, 4 footer, 5 done
+    bool first = true;
+    ChunkStage out;
+
+    // Newer than `since`, compared so it survives millis() wrapping
+    bool include(uint32_t t) const { return since == 0 || (int32_t)(t - since) > 0; }
+};
+
+// Fill `buffer` with the next piece of the history JSON; returns 0 when done.
+// Each chunk re-finds the device, so a slot reused mid-stream just ends the arrays.
+size_t historyFillJson(HistoryStore &store, HistoryCursor &cursor, uint8_t *buffer, size_t maxLen)
+{
+    char *out = (char *)buffer;
+    size_t len = cursor.out.drain(out, maxLen);
+    DeviceHistory *h = store.find(cursor.deviceId.c_str());
+
+    while (len < maxLen && cursor.stage < 5)
+    {
+        switch (cursor.stage)
+        {
+        case 0:
+            cursor.out.format("{\"since\":%u,\"now\":%u,\"gps\":[", (unsigned)cursor.since, (unsigned)millis());
+            cursor.next = h ? h->gps.oldest() : 0;
+            cursor.stage = 1;
+            break;
+
+        case 1:
+            if (!h || cursor.next >= h->gps.seq)
+            {
+                cursor.stage = 2;
+                break;
+            }
+            if (cursor.next < h->gps.oldest())
+                cursor.next = h->gps.oldest();
+            {
+                const GpsPoint &p = h->gps.at(cursor.next++);
+                if (!cursor.include(p.t))
+                    break;
+                cursor.out.format("%s[%u,%.7f,%.7f,%d,%.1f,%.2f]", cursor.first ? "" : ",", (unsigned)p.t,
+                                  p.lat / 1e7, p.lon / 1e7, p.alt, p.accuracy / 10.0, p.speed / 100.0);
+                cursor.first = false;
+            }
+            break;
+
+        case 2:
+            cursor.out.format("],\"imu\":[");
+            cursor.next = h ? h->imu.oldest() : 0;
+            cursor.first = true;
+            cursor.stage = 3;
+            break;
+
+        case 3:
+            if (!h || cursor.next >= h->imu.seq)
+            {
+                cursor.stage = 4;
+                break;
+            }
+            if (cursor.next < h->imu.oldest())
+                cursor.next = h->imu.oldest();
+            {
+                const ImuSummary &s = h->imu.at(cursor.next++);
+                if (!cursor.include(s.t))
+                    break;
+                cursor.out.format("%s[%u,%u,%.2f,%.2f,%.2f]", cursor.first ? "" : ",", (unsigned)s.t, s.count,
+                                  s.accelMean / 100.0, s.accelMax / 100.0, s.gyroMax / 100.0);
+                cursor.first = false;
+            }
+            break;
+
+        case 4:
+            cursor.out.format("],\"gpsFields\":[\"t\",\"lat\",\"lon\",\"alt\",\"accuracy\",\"speed\"],"
+                              "\"imuFields\":[\"t\",\"count\",\"accelMean\",\"accelMax\",\"gyroMax\"]}");
+            cursor.stage = 5;
+            break;
+        }
+        len += cursor.out.drain(out + len, maxLen - len);
+    }
+
+    return len;
+}
+
+#endif
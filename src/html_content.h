@@ -348,9 +348,17 @@ const char index_html[] PROGMEM = R"rawliteral(
         let deviceId = '';
         let dataSharingEnabled = false;
 
+        // Issued in REGISTERED; a reconnect presents it with RESUME to take back
+        // the same session on the bridge without re-registering
+        let resumeToken = localStorage.getItem('artemis_resumeToken');
+
         // Simulate sensor data (in real app, you'd get this from device sensors)
         let sensorInterval = null;
 
+        // Send rates, adjusted by the bridge with SET_RATE when the uplink is busy
+        let gpsIntervalMs = 2000;
+        let imuIntervalMs = 1000;
+
         function debugLog(msg) {
             console.log(msg);
         }
@@ -372,6 +380,7 @@ const char index_html[] PROGMEM = R"rawliteral(
                 ws.onopen = () => {
                     console.log("WebSocket Connected!");
                     updateConnectionStatus(true);
+                    if (resumeToken) resumeSession();
                 };
 
                 ws.onclose = (e) => {
@@ -462,16 +471,61 @@ const char index_html[] PROGMEM = R"rawliteral(
             ws.send(JSON.stringify(registerMsg));
         }
 
+        function resumeSession() {
+            ws.send(JSON.stringify({
+                type: 'RESUME',
+                deviceId: localStorage.getItem('artemis_deviceId'),
+                token: resumeToken
+            }));
+        }
+
+        function setResumeToken(token) {
+            resumeToken = token || null;
+            if (resumeToken) localStorage.setItem('artemis_resumeToken', resumeToken);
+            else localStorage.removeItem('artemis_resumeToken');
+        }
+
+        function showApp() {
+            document.getElementById('registerSection').classList.add('hidden');
+            document.getElementById('appSection').classList.remove('hidden');
+            document.getElementById('displayUsername').textContent = username;
+            document.getElementById('displayDeviceId').textContent = deviceId;
+
+            // Start simulating sensor data
+            startSensorSimulation();
+        }
+
         function handleMessage(data) {
-            if (data.type === 'REGISTERED') {
+            if (data.type === 'TIME_PING') {
+                // Clock sync: echo the bridge's t0 with our own clock so it can estimate the offset
+                if (ws && ws.readyState === WebSocket.OPEN) {
+                    ws.send(JSON.stringify({ type: 'TIME_PONG', t0: data.t0, t1: Date.now() }));
+                }
+            } else if (data.type === 'SET_RATE') {
+                gpsIntervalMs = data.gpsInterval || gpsIntervalMs;
+                const newImuInterval = data.imuInterval || imuIntervalMs;
+                if (newImuInterval !== imuIntervalMs) {
+                    imuIntervalMs = newImuInterval;
+                    if (sensorInterval) startSensorSimulation(); // Restart timer at the new rate
+                }
+                console.log(`Send rate: GPS ${gpsIntervalMs} ms, IMU ${imuIntervalMs} ms`);
+            } else if (data.type === 'REGISTERED') {
                 // Registration successful
-                document.getElementById('registerSection').classList.add('hidden');
-                document.getElementById('appSection').classList.remove('hidden');
-                document.getElementById('displayUsername').textContent = username;
-                document.getElementById('displayDeviceId').textContent = deviceId;
-
-                // Start simulating sensor data
-                startSensorSimulation();
+                setResumeToken(data.resumeToken);
+                showApp();
+            } else if (data.type === 'RESUMED') {
+                // Same session as before the drop; after a page reload pick the form values back up
+                username = username || localStorage.getItem('artemis_username');
+                deviceId = deviceId || localStorage.getItem('artemis_deviceId');
+                if (document.getElementById('appSection').classList.contains('hidden')) showApp();
+                if (data.sharing && !dataSharingEnabled) {
+                    document.getElementById('dataSharingToggle').checked = true;
+                    toggleDataSharing();
+                }
+            } else if (data.type === 'RESUME_FAILED') {
+                // Session expired on the bridge: register again with the saved details
+                setResumeToken(null);
+                registerUser(true);
             }
         }
 
@@ -557,7 +611,7 @@ const char index_html[] PROGMEM = R"rawliteral(
         let lastGpsTime = 0;
         function handleGpsPosition(position) {
             const now = Date.now();
-            if (now - lastGpsTime < 2000) return; // Throttle
+            if (now - lastGpsTime < gpsIntervalMs) return; // Throttle
             lastGpsTime = now;
 
             const gpsData = {
@@ -633,7 +687,7 @@ const char index_html[] PROGMEM = R"rawliteral(
                 if (ws && ws.readyState === WebSocket.OPEN) {
                     ws.send(JSON.stringify(imuData));
                 }
-            }, 1000);
+            }, imuIntervalMs);
         }
 
         function disconnect() {
@@ -643,6 +697,7 @@ const char index_html[] PROGMEM = R"rawliteral(
             // Clear LocalStorage on explicit logout
             localStorage.removeItem('artemis_username');
             localStorage.removeItem('artemis_deviceId');
+            setResumeToken(null);
             
             if (ws) {
                 ws.close();
@@ -676,10 +731,10 @@ const char index_html[] PROGMEM = R"rawliteral(
                 document.getElementById('username').value = savedUser;
                 document.getElementById('deviceId').value = savedDevice;
                 
-                // Try to auto-login when socket connects
+                // Try to auto-login when socket connects (onopen resumes instead if we hold a token)
                 const checkSocket = setInterval(() => {
                     if (ws && ws.readyState === WebSocket.OPEN) {
-                        registerUser(true); // true = isAutoLogin
+                        if (!resumeToken) registerUser(true); // true = isAutoLogin
                         clearInterval(checkSocket);
                     }
                 }, 500);
@@ -0,0 +1,195 @@
+#ifndef JSON_TEMPLATES_H
+#define JSON_TEMPLATES_H
+
+#include <Arduino.h>
+#include <memory>
+
+// Prebuilt control messages. Their shape never changes, so instead of a
+// JsonDocument per message the fixed parts are string literals and only the
+// few variable fields are written, escaped, into a caller-provided buffer.
+// Builders return the full length like snprintf: if it is >= the buffer
+// size the output was truncated and the caller retries with a bigger one
+// (JsonBuffer below does that for oversized user names).
+
+// Sequential JSON writer over a fixed buffer; counts what it could not fit
+class JsonWriter
+{
+public:
+    JsonWriter(char *out, size_t cap) : _out(out), _cap(cap)
+    {
+        if (cap)
+            out[0] = '\0';
+    }
+
+    JsonWriter &raw(const char *s)
+    {
+        while (*s)
+            put(*s++);
+        return *this;
+    }
+
+    // Quoted string with the escapes JSON requires; UTF-8 passes through
+    JsonWriter &str(const char *s)
+    {
+        put('"');
+        for (; *s; s++)
+        {
+            unsigned char c = *s;
+            switch (c)
+            {
+            case '"':
+                raw("\\\"");
+                break;
+            case '\\':
+                raw("\\\\");
+                break;
+            case '\n':
+                raw("\\n");
+                break;
+            case '\r':
+                raw("\\r");
+                break;
+            case '\t':
+                raw("\\t");
+                break;
+            case '\b':
+                raw("\\b");
+                break;
+            case '\f':
+                raw("\\f");
+                break;
+            default:
+                if (c < 0x20)
+                {
+                    char esc[7];
+                    snprintf(esc, sizeof(esc), "\\u%04x", c);
+                    raw(esc);
+                }
+                else
+                {
+                    put(c);
+                }
+            }
+        }
+        put('"');
+        return *this;
+    }
+
+    JsonWriter &str(const String &s) { return str(s.c_str()); }
+
+    JsonWriter &num(uint32_t v)
+    {
+        char digits[10];
+        size_t n = 0;
+        do
+        {
+            digits[n++] = '0' + v % 10;
+            v /= 10;
+        } while (v);
+        while (n)
+            put(digits[--n]);
+        return *this;
+    }
+
+    // Characters the message needs, excluding the terminator
+    size_t length() const { return _len; }
+
+private:
+    char *_out;
+    size_t _cap;
+    size_t _len = 0;
+
+    void put(char c)
+    {
+        if (_len + 1 < _cap)
+        {
+            _out[_len] = c;
+            _out[_len + 1] = '\0';
+        }
+        _len++;
+    }
+};
+
+// Stack storage for one message, moving to the heap only when it does not fit
+template <size_t N>
+struct JsonBuffer
+{
+    char local[N];
+    std::unique_ptr<char[]> heap;
+
+    static const size_t SIZE = N;
+
+    // Room for `len` characters plus the terminator
+    char *grow(size_t len)
+    {
+        heap.reset(new char[len + 1]);
+        return heap.get();
+    }
+};
+
+// ====== Constant replies (flash; main.cpp pins each in one shared send buffer) ======
+const char JSON_RESUME_FAILED[] = "{\"type\":\"RESUME_FAILED\"}";
+const char JSON_RESUMED_SHARING[] = "{\"type\":\"RESUMED\",\"sharing\":true}";
+const char JSON_RESUMED_PAUSED[] = "{\"type\":\"RESUMED\",\"sharing\":false}";
+const char JSON_CONFIG_UNAUTHORIZED[] = "{\"type\":\"CONFIG\",\"error\":\"unauthorized\"}";
+const char JSON_MESSAGE_TOO_LARGE[] = "{\"type\":\"ERROR\",\"error\":\"message too large\"}";
+const char JSON_GEOFENCE_UNAUTHORIZED[] = "{\"type\":\"GEOFENCE_SET_RESULT\",\"error\":\"unauthorized\"}";
+
+// ====== Templates ======
+
+inline size_t jsonRegistered(char *out, size_t cap, const String &resumeToken)
+{
+    return JsonWriter(out, cap)
+        .raw("{\"type\":\"REGISTERED\",\"resumeToken\":")
+        .str(resumeToken)
+        .raw("}")
+        .length();
+}
+
+inline size_t jsonUserConnected(char *out, size_t cap, const String &username, const String &deviceId,
+                                uint32_t clientId, uint32_t version)
+{
+    return JsonWriter(out, cap)
+        .raw("{\"type\":\"USER_CONNECTED\",\"username\":")
+        .str(username)
+        .raw(",\"deviceId\":")
+        .str(deviceId)
+        .raw(",\"clientId\":")
+        .num(clientId)
+        .raw(",\"v\":")
+        .num(version)
+        .raw("}")
+        .length();
+}
+
+inline size_t jsonUserDisconnect(char *out, size_t cap, const String &username, const String &deviceId,
+                                 uint32_t version)
+{
+    return JsonWriter(out, cap)
+        .raw("{\"type\":\"USER_DISCONNECT\",\"username\":")
+        .str(username)
+        .raw(",\"deviceId\":")
+        .str(deviceId)
+        .raw(",\"v\":")
+        .num(version)
+        .raw("}")
+        .length();
+}
+
+inline size_t jsonTimePing(char *out, size_t cap, uint32_t t0)
+{
+    return JsonWriter(out, cap).raw("{\"type\":\"TIME_PING\",\"t0\":").num(t0).raw("}").length();
+}
+
+inline size_t jsonSetRate(char *out, size_t cap, uint32_t gpsInterval, uint32_t imuInterval)
+{
+    return JsonWriter(out, cap)
+        .raw("{\"type\":\"SET_RATE\",\"gpsInterval\":")
+        .num(gpsInterval)
+        .raw(",\"imuInterval\":")
+        .num(imuInterval)
+        .raw("}")
+        .length();
+}
+
+#endif
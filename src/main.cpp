@@ -2,9 +2,34 @@
 #include <ESPAsyncWebServer.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
+#include <LittleFS.h>
 #include <map>
 #include "html_content.h" // User app HTML
 #include "config.h"       // WiFi and Server configuration
+#include "clock_sync.h"   // Per-session clock offset estimation
+#include "ws_outbox.h"    // Per-client backlog for slow WebSocket clients
+#include "deflate_lite.h" // Uplink batch compression
+#include "msg_router.h"   // WebSocket message type dispatch
+#include "trace.h"        // Optional timeline tracing (-DARTEMIS_TRACE)
+#include "rate_control.h" // Adaptive phone send rates
+#include "state_cache.h"  // Last-known device state for snapshots
+#include "history_ring.h" // Short-term per-device history
+#include "fusion.h"       // Per-session GPS/IMU Kalman filter
+#include "geofence.h"     // Zone index and enter/exit detection
+#include "uplink_pool.h"  // Flask server failover and circuit breakers
+#include "uplink_queue.h" // Records waiting for Flask
+#include "runtime_config.h" // Tunables kept in NVS
+#include "heap_monitor.h"  // Periodic heap health log and leak trend
+#include "json_templates.h" // Prebuilt control messages
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Live tunables: loaded from NVS in setup(), changed through CONFIG_SET or
+// /api/config. configChanged asks loop() to resize what depends on them.
+RuntimeConfig settings;
+ConfigStore configStore;
+volatile bool configChanged = false;
 
 AsyncWebServer server(WEBSOCKET_PORT);
 AsyncWebSocket ws(WEBSOCKET_PATH);
@@ -19,164 +44,1073 @@ struct UserSession
     bool dataSharingEnabled;
     bool disconnectPending;
     unsigned long disconnectTime;
+    bool offlineAnnounced = false; // USER_DISCONNECT already sent for this drop
+    String resumeToken;            // Lets a reconnecting phone take the session back
+    bool superseded = false;       // Replaced by a newer session for the device; loop() drops it silently
+    ClockSync clock;
+    FusionFilter fusion;
+    unsigned long lastFused = 0;
+    std::vector<uint16_t> fencesInside; // Sorted fence indices at the last fix
 };
 
+// Session state shared by the async_tcp task (WebSocket events, HTTP
+// handlers) and loop(): activeSessions with everything inside each session,
+// and stateCache. Recursive because closing a client while holding it can
+// run that client's disconnect event on the spot. Taken before outboxLock.
+std::recursive_mutex sessionLock;
+
 std::map<uint32_t, UserSession> activeSessions;
 
+size_t sessionCount()
+{
+    std::lock_guard<std::recursive_mutex> lock(sessionLock);
+    return activeSessions.size();
+}
+
+// Latest state per device, served as SNAPSHOT / /api/devices
+StateCache stateCache;
+
+// Recent GPS points and IMU summaries, served from /api/device/<id>/history
+HistoryStore history;
+
+// Filter update cost, measured in CPU cycles
+struct FusionStats
+{
+    uint32_t updates = 0;
+    uint64_t cycles = 0;
+    uint32_t maxCycles = 0;
+    uint32_t overBudget = 0; // Updates slower than FUSION_CYCLE_BUDGET
+} fusionStats;
+
+// Fences pushed with GEOFENCE_SET; each session remembers which it was inside
+GeofenceIndex geofences;
+
+struct GeofenceStats
+{
+    uint32_t checks = 0;
+    uint64_t cycles = 0;
+    uint32_t maxCycles = 0;
+    uint32_t events = 0;
+} geofenceStats;
+
+// Outbound backlog per connected WebSocket client (touched from both the
+// async_tcp task and loop(), so guarded by outboxLock)
+std::map<uint32_t, ClientOutbox> outboxes;
+std::mutex outboxLock;
+
 // Queue for data to send to Flask (to avoid blocking WebSocket handler)
-#include <queue>
-std::queue<String> flaskQueue;
+UplinkQueue uplinkQueue;
+
+// Uplink compressor (fixed ~6 KB of tables) and running stats for /api/metrics
+DeflateLite uplinkDeflate;
+
+struct UplinkStats
+{
+    uint32_t batches = 0;
+    uint32_t records = 0;
+    uint64_t rawBytes = 0;
+    uint64_t wireBytes = 0;
+    uint32_t compressMicros = 0; // Last batch
+    uint32_t maxCompressMicros = 0;
+    float latencyMs = 0; // Smoothed POST round trip, failures count as the full timeout
+    uint32_t dropped = 0; // Records given up on after maxAttempts, or cut by a smaller queue
+} uplinkStats;
+
+UplinkPool uplinkPool;
+
+RateController rateController;
+unsigned long lastRateEval = 0;
+
+HeapMonitor heapMonitor;
+unsigned long lastHeapSample = 0;
 
 // Queue data for Flask server (called from WebSocket handler)
 void queueForFlask(const JsonDocument &doc)
 {
     String jsonString;
     serializeJson(doc, jsonString);
-    if (flaskQueue.size() < 10)
-    { // Limit queue size
-        flaskQueue.push(jsonString);
-    }
+    uplinkQueue.push(jsonString, settings.queueSize); // Dropped when full
+}
+
+// Same for a message that is already serialized
+void queueForFlask(const char *json)
+{
+    uplinkQueue.push(String(json), settings.queueSize);
 }
 
-// Actually send data to Flask server (called from loop)
-void sendToFlaskServer(const String &jsonString)
+// With fences loaded and geoEventsOnly set, the Flask server only wants the
+// crossings: positions (GPS and FUSED) stay on the local WebSocket
+bool uplinkPositions()
 {
+    return !settings.geoEventsOnly || geofences.size() == 0;
+}
+
+// Actually send data to Flask server (called from loop). Returns true once
+// the server has answered without a 5xx, i.e. the batch needs no retry.
+bool sendToFlaskServer(const String &jsonString, int endpointIndex)
+{
+    TRACE_SCOPE("sendToFlaskServer");
+
     if (WiFi.status() != WL_CONNECTED)
     {
         Serial.println("❌ Not connected to home WiFi, cannot forward to Flask");
-        return;
+        uplinkPool.release(endpointIndex);
+        return false;
     }
 
     // Serial.println("📡 Forwarding data to Flask server..."); // Reduced serial spam
     HTTPClient http;
-    String serverUrl = String("http://") + FLASK_SERVER_IP + ":" + String(FLASK_SERVER_PORT) + "/api/esp32/data";
+    const String &serverUrl = uplinkPool.endpoint(endpointIndex).url;
 
     // Serial.printf("   URL: %s\n", serverUrl.c_str());
 
     http.begin(serverUrl);
-    http.setTimeout(2000); // 2 seconds timeout
+    http.setConnectTimeout(settings.connectTimeout);
+    http.setTimeout(settings.httpTimeout);
     http.addHeader("Content-Type", "application/json");
     http.addHeader("Connection", "keep-alive"); // Attempt to keep connection alive
 
-    int httpResponseCode = http.POST(jsonString);
+    int httpResponseCode;
+    size_t wireBytes = jsonString.length();
+    uint8_t *compressed = nullptr;
+
+    if (settings.compress && jsonString.length() >= settings.compressMin)
+    {
+        // Only worth sending compressed if it comes out smaller than the input
+        compressed = (uint8_t *)malloc(jsonString.length());
+        if (compressed)
+        {
+            TRACE_SCOPE("compressBatch");
+            unsigned long start = micros();
+            wireBytes = uplinkDeflate.compress((const uint8_t *)jsonString.c_str(), jsonString.length(),
+                                               compressed, jsonString.length());
+            uplinkStats.compressMicros = micros() - start;
+            if (uplinkStats.compressMicros > uplinkStats.maxCompressMicros)
+                uplinkStats.maxCompressMicros = uplinkStats.compressMicros;
+
+            if (wireBytes == 0)
+            {
+                free(compressed);
+                compressed = nullptr;
+                wireBytes = jsonString.length();
+            }
+        }
+    }
+
+    unsigned long postStart = millis();
+    if (compressed)
+    {
+        http.addHeader("Content-Encoding", "deflate");
+        httpResponseCode = http.POST(compressed, wireBytes);
+        free(compressed);
+    }
+    else
+    {
+        httpResponseCode = http.POST(jsonString);
+    }
+
+    unsigned long latency = httpResponseCode > 0 ? millis() - postStart : settings.httpTimeout;
+    uplinkStats.latencyMs += (latency - uplinkStats.latencyMs) / 8;
+    uplinkStats.batches++;
+    uplinkStats.rawBytes += jsonString.length();
+    uplinkStats.wireBytes += wireBytes;
+
+    bool ok = httpResponseCode > 0 && httpResponseCode < 500;
+    uplinkPool.report(endpointIndex, ok, latency, millis());
 
     if (httpResponseCode > 0)
     {
         // Serial.printf("✅ Data forwarded to Flask: %d\n", httpResponseCode);
+        if (!ok)
+            Serial.printf("❌ Flask %s answered %d\n", serverUrl.c_str(), httpResponseCode);
     }
     else
     {
-        Serial.printf("❌ Error forwarding to Flask: %s\n", http.errorToString(httpResponseCode).c_str());
+        Serial.printf("❌ Error forwarding to Flask %s: %s\n", serverUrl.c_str(), http.errorToString(httpResponseCode).c_str());
     }
 
     http.end();
+    return ok;
+}
+
+// Fan a message out to every client. Clients that are keeping up share one
+// library buffer, copied once per broadcast; clients whose send queue is full
+// share one parked copy in their outbox under `key`, replacing any older
+// message for the same key, so one slow viewer cannot hold up the rest.
+void broadcastText(const char *msg, size_t len, const String &key)
+{
+    TRACE_SCOPE("broadcastText");
+    std::lock_guard<std::mutex> lock(outboxLock);
+    AsyncWebSocketMessageBuffer *shared = nullptr;
+    ParkedText parked;
+    for (auto &entry : outboxes)
+    {
+        AsyncWebSocketClient *client = ws.client(entry.first);
+        if (!client || client->status() != WS_CONNECTED)
+            continue;
+
+        ClientOutbox &box = entry.second;
+        if (box.pending.empty() && !client->queueIsFull())
+        {
+            if (!shared)
+            {
+                shared = ws.makeBuffer((uint8_t *)msg, len);
+                if (!shared)
+                    continue; // Out of heap; this client misses one frame
+                shared->lock(); // Held until every client has its reference
+            }
+            client->text(shared);
+            box.sent++;
+        }
+        else
+        {
+            if (!parked)
+                parked = std::make_shared<const String>(msg);
+            box.defer(key, parked);
+            box.trimTo(settings.backlogBudget);
+        }
+    }
+
+    if (shared)
+    {
+        shared->unlock();
+        ws._cleanBuffers();
+    }
+}
+
+void broadcastText(const String &msg, const String &key)
+{
+    broadcastText(msg.c_str(), msg.length(), key);
+}
+
+// Constant replies, copied once at startup into library buffers that stay
+// locked for the life of the server. A send hands the client a reference to
+// the shared buffer instead of a fresh copy of the text.
+struct PinnedReply
+{
+    const char *text;
+    size_t len;
+    AsyncWebSocketMessageBuffer *buffer;
+};
+
+#define PINNED_REPLY(json) {json, sizeof(json) - 1, nullptr}
+PinnedReply replyResumeFailed = PINNED_REPLY(JSON_RESUME_FAILED);
+PinnedReply replyResumedSharing = PINNED_REPLY(JSON_RESUMED_SHARING);
+PinnedReply replyResumedPaused = PINNED_REPLY(JSON_RESUMED_PAUSED);
+PinnedReply replyConfigUnauthorized = PINNED_REPLY(JSON_CONFIG_UNAUTHORIZED);
+PinnedReply replyMessageTooLarge = PINNED_REPLY(JSON_MESSAGE_TOO_LARGE);
+PinnedReply replyGeofenceUnauthorized = PINNED_REPLY(JSON_GEOFENCE_UNAUTHORIZED);
+#undef PINNED_REPLY
+
+void pinReplies()
+{
+    for (PinnedReply *reply : {&replyResumeFailed, &replyResumedSharing, &replyResumedPaused,
+                               &replyConfigUnauthorized, &replyMessageTooLarge, &replyGeofenceUnauthorized})
+    {
+        reply->buffer = ws.makeBuffer((uint8_t *)reply->text, reply->len);
+        if (reply->buffer)
+            reply->buffer->lock(); // Never unlocked, so _cleanBuffers() keeps it
+    }
+}
+
+void sendReply(AsyncWebSocketClient *client, const PinnedReply &reply)
+{
+    if (reply.buffer)
+        client->text(reply.buffer);
+    else
+        client->text(reply.text, reply.len); // Pinning ran out of heap at boot
+}
+
+// Flush parked messages to clients that have drained, and drop clients that
+// stay stalled or cannot get under budget even with telemetry coalesced
+void drainOutboxes()
+{
+    TRACE_SCOPE("drainOutboxes");
+    std::vector<uint32_t> stalled;
+    {
+        std::lock_guard<std::mutex> lock(outboxLock);
+        unsigned long now = millis();
+        for (auto &entry : outboxes)
+        {
+            ClientOutbox &box = entry.second;
+            if (box.pending.empty())
+                continue;
+
+            AsyncWebSocketClient *client = ws.client(entry.first);
+            if (!client || client->status() != WS_CONNECTED)
+                continue;
+
+            while (!box.pending.empty() && !client->queueIsFull())
+            {
+                client->text(*box.pending.begin()->second);
+                box.popFront();
+            }
+
+            if (box.stalledSince != 0 &&
+                (now - box.stalledSince > settings.stallTimeout || box.pendingBytes > settings.backlogBudget))
+            {
+                Serial.printf("⚠️ Closing stalled client #%u (%u bytes backlog)\n", entry.first, (unsigned)box.pendingBytes);
+                box = ClientOutbox();
+                stalled.push_back(entry.first);
+            }
+        }
+    }
+
+    // Close outside the lock: the disconnect event handler takes it too
+    for (uint32_t id : stalled)
+    {
+        AsyncWebSocketClient *client = ws.client(id);
+        if (client)
+            client->close();
+    }
+}
+
+// Send a TIME_PING to a session; the phone echoes t0 back with its own clock
+void sendClockPing(UserSession &session)
+{
+    AsyncWebSocketClient *client = ws.client(session.clientId);
+    if (!client || client->status() != WS_CONNECTED)
+        return;
+
+    session.clock.lastPing = millis();
+
+    char pingMsg[48];
+    client->text(pingMsg, jsonTimePing(pingMsg, sizeof(pingMsg), session.clock.lastPing));
+}
+
+// Push the current GPS/IMU intervals to one phone
+void sendRate(UserSession &session)
+{
+    AsyncWebSocketClient *client = ws.client(session.clientId);
+    if (!client || client->status() != WS_CONNECTED)
+        return;
+
+    char rateMsg[72];
+    client->text(rateMsg, jsonSetRate(rateMsg, sizeof(rateMsg), rateController.current().gpsInterval,
+                                      rateController.current().imuInterval));
+}
+
+// Broadcast and uplink the session's smoothed position, velocity and heading
+void sendFused(UserSession &session, unsigned long now)
+{
+    double lat, lon;
+    float ve, vn;
+    session.fusion.estimate(now, lat, lon, ve, vn);
+
+    float heading = atan2f(ve, vn) * RAD_TO_DEG; // 0 = north, clockwise
+    if (heading < 0)
+        heading += 360.0f;
+
+    JsonDocument fusedDoc;
+    fusedDoc["type"] = "FUSED";
+    fusedDoc["username"] = session.username;
+    fusedDoc["deviceId"] = session.deviceId;
+    fusedDoc["lat"] = lat;
+    fusedDoc["lon"] = lon;
+    fusedDoc["ve"] = ve;
+    fusedDoc["vn"] = vn;
+    fusedDoc["speed"] = sqrtf(ve * ve + vn * vn) * 3.6f; // km/h, like GPS frames
+    fusedDoc["heading"] = heading;
+    fusedDoc["posStd"] = session.fusion.positionStd();
+    fusedDoc["bridgeTs"] = now;
+
+    String fusedMsg;
+    serializeJson(fusedDoc, fusedMsg);
+    broadcastText(fusedMsg, "1:FUSED:" + session.deviceId);
+    if (uplinkPositions())
+        queueForFlask(fusedDoc);
+}
+
+// Broadcast and uplink one boundary crossing. Keyed per device and fence, so a
+// slow viewer that missed both sides of a crossing gets the latest one.
+void sendGeofenceEvent(UserSession &session, const Geofence &fence, bool enter,
+                       double lat, double lon, uint32_t bridgeTs)
+{
+    JsonDocument eventDoc;
+    eventDoc["type"] = enter ? "GEOFENCE_ENTER" : "GEOFENCE_EXIT";
+    eventDoc["username"] = session.username;
+    eventDoc["deviceId"] = session.deviceId;
+    eventDoc["fenceId"] = fence.id;
+    eventDoc["lat"] = lat;
+    eventDoc["lon"] = lon;
+    eventDoc["bridgeTs"] = bridgeTs;
+
+    String eventMsg;
+    serializeJson(eventDoc, eventMsg);
+    broadcastText(eventMsg, "0:GEOFENCE:" + session.deviceId + ":" + fence.id);
+    queueForFlask(eventDoc);
+
+    geofenceStats.events++;
+    Serial.printf("%s %s fence %s\n", session.username.c_str(), enter ? "entered" : "left", fence.id.c_str());
+}
+
+// Evaluate a GPS fix against the fence index and emit a crossing for every
+// fence the device entered or left since its previous fix
+void checkGeofences(UserSession &session, double lat, double lon, uint32_t bridgeTs)
+{
+    if (geofences.size() == 0)
+        return;
+
+    static std::vector<uint16_t> inside; // Reused across fixes; only touched from the async_tcp task
+    uint32_t cycles = ESP.getCycleCount();
+    geofences.query(lat, lon, inside);
+    cycles = ESP.getCycleCount() - cycles;
+
+    geofenceStats.checks++;
+    geofenceStats.cycles += cycles;
+    if (cycles > geofenceStats.maxCycles)
+        geofenceStats.maxCycles = cycles;
+
+    std::vector<uint16_t> &previous = session.fencesInside;
+    if (inside == previous)
+        return;
+
+    // Both lists are sorted: walk them together
+    size_t i = 0, j = 0;
+    while (i < previous.size() || j < inside.size())
+    {
+        if (j == inside.size() || (i < previous.size() && previous[i] < inside[j]))
+            sendGeofenceEvent(session, geofences.fence(previous[i++]), false, lat, lon, bridgeTs);
+        else if (i == previous.size() || inside[j] < previous[i])
+            sendGeofenceEvent(session, geofences.fence(inside[j++]), true, lat, lon, bridgeTs);
+        else
+            i++, j++;
+    }
+    previous = inside;
+}
+
+// Re-evaluate uplink pressure and tell every phone if its rate changes
+void updateSendRates()
+{
+    std::lock_guard<std::recursive_mutex> lock(sessionLock);
+    size_t sharing = 0;
+    for (auto &entry : activeSessions)
+    {
+        if (!entry.second.disconnectPending && entry.second.dataSharingEnabled)
+            sharing++;
+    }
+
+    rateController.minLevel = settings.rateMinLevel;
+    rateController.maxLevel = max(settings.rateMinLevel, settings.rateMaxLevel);
+
+    float pressure = (float)uplinkQueue.size() / settings.queueSize;
+    pressure = max(pressure, uplinkStats.latencyMs / settings.latencyTarget);
+    pressure = max(pressure, (float)sharing / settings.sessionBudget);
+
+    if (!rateController.update(pressure, millis()))
+        return;
+
+    Serial.printf("Send rate level %u (GPS %u ms, IMU %u ms), pressure %.2f\n",
+                  rateController.level, rateController.current().gpsInterval,
+                  rateController.current().imuInterval, pressure);
+
+    for (auto &entry : activeSessions)
+    {
+        if (!entry.second.disconnectPending)
+            sendRate(entry.second);
+    }
+}
+
+// Bring state sized by the config back in line after a change. Runs from
+// loop(), which owns the uplink batch, so nothing is resized mid-send.
+void applyRuntimeConfig()
+{
+    // Queue shrunk: drop the oldest records, as a full queue would drop the newest
+    uplinkStats.dropped += uplinkQueue.trim(settings.queueSize);
+
+    {
+        std::lock_guard<std::mutex> lock(outboxLock);
+        for (auto &entry : outboxes)
+            entry.second.trimTo(settings.backlogBudget);
+    }
+
+    // Picks up new rate bounds and pushes SET_RATE if the level moves
+    updateSendRates();
+}
+
+// Admin check shared by the WebSocket messages and /api/config
+bool isAdmin(const char *token)
+{
+    return token && strcmp(token, ADMIN_TOKEN) == 0;
+}
+
+// Apply {"reset": true, "values": {key: value}} to the live config; keys that
+// are unknown or out of range are listed in `rejected` and left unchanged
+void updateRuntimeConfig(JsonObjectConst request, JsonArray rejected)
+{
+    if (request["reset"] | false)
+        configStore.reset(settings);
+
+    for (JsonPairConst kv : request["values"].as<JsonObjectConst>())
+    {
+        if (!configStore.set(settings, kv.key().c_str(), kv.value()))
+            rejected.add(kv.key());
+    }
+    configChanged = true;
+}
+
+// SNAPSHOT of devices changed after `since` (all of them when the client is
+// too far behind). Followed live by broadcasts carrying "v".
+String buildSnapshotJson(uint32_t since)
+{
+    std::lock_guard<std::recursive_mutex> lock(sessionLock);
+    bool full = stateCache.needsFull(since);
+
+    JsonDocument doc;
+    doc["type"] = "SNAPSHOT";
+    doc["version"] = stateCache.version;
+    doc["full"] = full;
+
+    JsonArray devices = doc["devices"].to<JsonArray>();
+    for (auto &entry : stateCache.devices)
+    {
+        const DeviceState &state = entry.second;
+        if (!full && state.version <= since)
+            continue;
+
+        JsonObject device = devices.add<JsonObject>();
+        device["deviceId"] = entry.first;
+        device["username"] = state.username;
+        device["online"] = state.online;
+        device["v"] = state.version;
+        if (state.gps.length())
+            device["gps"] = serialized(state.gps);
+        if (state.imu.length())
+            device["imu"] = serialized(state.imu);
+    }
+
+    String output;
+    serializeJson(doc, output);
+    return output;
+}
+
+// Tell dashboards and Flask that a phone is online
+void announceConnected(UserSession &session)
+{
+    uint32_t version = stateCache.setOnline(session.deviceId, session.username, true);
+
+    JsonBuffer<160> buffer;
+    char *notifyMsg = buffer.local;
+    size_t len = jsonUserConnected(notifyMsg, buffer.SIZE, session.username, session.deviceId, session.clientId, version);
+    if (len >= buffer.SIZE)
+    {
+        notifyMsg = buffer.grow(len);
+        jsonUserConnected(notifyMsg, len + 1, session.username, session.deviceId, session.clientId, version);
+    }
+
+    broadcastText(notifyMsg, len, "0:" + session.deviceId);
+    queueForFlask(notifyMsg);
+}
+
+// Tell dashboards and Flask that a phone has gone; held back until
+// the resume grace period has passed so a quick reconnect stays invisible
+void announceDisconnected(UserSession &session)
+{
+    session.offlineAnnounced = true;
+    uint32_t version = stateCache.setOnline(session.deviceId, session.username, false);
+
+    JsonBuffer<128> buffer;
+    char *alertMsg = buffer.local;
+    size_t len = jsonUserDisconnect(alertMsg, buffer.SIZE, session.username, session.deviceId, version);
+    if (len >= buffer.SIZE)
+    {
+        alertMsg = buffer.grow(len);
+        jsonUserDisconnect(alertMsg, len + 1, session.username, session.deviceId, version);
+    }
+
+    broadcastText(alertMsg, len, "0:" + session.deviceId);
+    queueForFlask(alertMsg);
+}
+
+// Retire a session whose device now lives under another client id. Only
+// loop() erases sessions, so this just flags it for removal.
+void supersede(UserSession &session)
+{
+    session.superseded = true;
+    session.disconnectPending = true;
+    session.resumeToken = "";
+}
+
+// 64 random bits as hex, handed to the phone in REGISTERED
+String makeResumeToken()
+{
+    char token[17];
+    snprintf(token, sizeof(token), "%08x%08x", (unsigned)esp_random(), (unsigned)esp_random());
+    return String(token);
+}
+
+// ====== WebSocket message handlers ======
+// session is null only for routes registered with needsSession = false
+
+void handleRegister(AsyncWebSocketClient *client, JsonDocument &doc, UserSession *, MsgType)
+{
+    UserSession session;
+    session.username = doc["username"].as<String>();
+    session.deviceId = doc["deviceId"].as<String>();
+    session.clientId = client->id();
+    session.lastSeen = millis();
+    session.dataSharingEnabled = false;
+    session.disconnectPending = false;
+    session.resumeToken = makeResumeToken();
+
+    // A fresh REGISTER replaces any older session for the same device, so its
+    // delayed USER_DISCONNECT cannot later mark the device offline
+    for (auto &entry : activeSessions)
+    {
+        if (entry.first != client->id() && entry.second.deviceId == session.deviceId)
+        {
+            session.fencesInside = entry.second.fencesInside; // Same device, no repeated ENTER
+            supersede(entry.second);
+        }
+    }
+
+    UserSession &registered = activeSessions[client->id()] = session;
+    sendClockPing(registered);
+
+    // Send confirmation to the registering client (the token is 16 hex digits)
+    char confirmMsg[64];
+    client->text(confirmMsg, jsonRegistered(confirmMsg, sizeof(confirmMsg), registered.resumeToken));
+    sendRate(registered);
+
+    // Broadcast USER_CONNECTED to all other clients (dashboards) and Flask
+    announceConnected(registered);
+
+    Serial.printf("User registered: %s (%s)\n", session.username.c_str(), session.deviceId.c_str());
+}
+
+// Reconnecting phone presenting the token from REGISTERED: move its session,
+// with sharing flag, clock and filter state, onto the new socket. Nothing is
+// broadcast unless the drop had already been announced.
+void handleResume(AsyncWebSocketClient *client, JsonDocument &doc, UserSession *, MsgType)
+{
+    const char *deviceId = doc["deviceId"] | "";
+    const char *token = doc["token"] | "";
+
+    auto it = activeSessions.begin();
+    while (it != activeSessions.end() &&
+           !(it->second.deviceId == deviceId && it->second.resumeToken.length() && it->second.resumeToken == token))
+        ++it;
+
+    if (it == activeSessions.end())
+    {
+        sendReply(client, replyResumeFailed); // Phone falls back to REGISTER
+        return;
+    }
+
+    uint32_t oldClientId = it->first;
+    UserSession resumed = it->second;
+    if (oldClientId != client->id())
+        supersede(it->second);
+
+    bool wasAnnounced = resumed.offlineAnnounced;
+    resumed.clientId = client->id();
+    resumed.lastSeen = millis();
+    resumed.disconnectPending = false;
+    resumed.offlineAnnounced = false;
+    UserSession &session = activeSessions[client->id()] = resumed;
+
+    // The old socket may not have timed out yet; it no longer owns a session
+    if (oldClientId != client->id())
+    {
+        AsyncWebSocketClient *oldClient = ws.client(oldClientId);
+        if (oldClient)
+            oldClient->close();
+    }
+
+    if (session.dataSharingEnabled)
+        sendReply(client, replyResumedSharing);
+    else
+        sendReply(client, replyResumedPaused);
+    sendRate(session);
+    sendClockPing(session);
+
+    if (wasAnnounced)
+        announceConnected(session);
+
+    Serial.printf("Session resumed: %s (%s)%s\n", session.username.c_str(), session.deviceId.c_str(),
+                  wasAnnounced ? ", re-announced" : "");
+}
+
+void handleEnableSharing(AsyncWebSocketClient *, JsonDocument &doc, UserSession *session, MsgType)
+{
+    bool enabled = doc["enabled"].as<bool>();
+    session->dataSharingEnabled = enabled;
+
+    Serial.printf("Data sharing %s for %s\n",
+                  enabled ? "enabled" : "disabled",
+                  session->username.c_str());
+}
+
+void handleTimePong(AsyncWebSocketClient *, JsonDocument &doc, UserSession *session, MsgType)
+{
+    session->clock.addSample(doc["t0"].as<uint32_t>(), doc["t1"].as<int64_t>(), millis());
+}
+
+// GPS and IMU frames
+void handleSensorData(AsyncWebSocketClient *, JsonDocument &doc, UserSession *session, MsgType msgType)
+{
+    session->lastSeen = millis();
+
+    if (!session->dataSharingEnabled)
+        return;
+
+    // Stamp the sample in the bridge timebase so frames from
+    // different phones can be ordered and merged downstream
+    if (session->clock.synced() && doc["timestamp"].is<int64_t>())
+    {
+        doc["bridgeTs"] = session->clock.toBridgeTime(doc["timestamp"].as<int64_t>());
+        doc["rtt"] = session->clock.rtt;
+    }
+    else
+    {
+        doc["bridgeTs"] = session->lastSeen;
+    }
+
+    uint32_t bridgeTs = doc["bridgeTs"].as<uint32_t>();
+    uint32_t cycles;
+    if (msgType == MsgType::Gps)
+    {
+        double lat = doc["lat"], lon = doc["lon"];
+        float accuracy = doc["accuracy"];
+        history.addGps(session->deviceId.c_str(), bridgeTs, lat, lon,
+                       doc["alt"].as<float>(), accuracy, doc["speed"].as<float>());
+
+        cycles = ESP.getCycleCount();
+        session->fusion.observeGps(bridgeTs, lat, lon, accuracy);
+        cycles = ESP.getCycleCount() - cycles;
+
+        checkGeofences(*session, lat, lon, bridgeTs);
+    }
+    else
+    {
+        float ax = doc["accel"]["x"], ay = doc["accel"]["y"], az = doc["accel"]["z"];
+        float gx = doc["gyro"]["x"], gy = doc["gyro"]["y"], gz = doc["gyro"]["z"];
+        float accelMag = sqrtf(ax * ax + ay * ay + az * az);
+        history.addImu(session->deviceId.c_str(), bridgeTs, accelMag, sqrtf(gx * gx + gy * gy + gz * gz));
+
+        cycles = ESP.getCycleCount();
+        session->fusion.observeImu(bridgeTs, accelMag);
+        cycles = ESP.getCycleCount() - cycles;
+    }
+
+    fusionStats.updates++;
+    fusionStats.cycles += cycles;
+    if (cycles > fusionStats.maxCycles)
+        fusionStats.maxCycles = cycles;
+    if (cycles > FUSION_CYCLE_BUDGET)
+        fusionStats.overBudget++;
+
+    // Tag as a delta on the cached state, then keep the frame for snapshots
+    doc["v"] = stateCache.setOnline(session->deviceId, session->username, true);
+
+    // Broadcast to local WebSocket clients
+    String output;
+    serializeJson(doc, output);
+    stateCache.storeFrame(session->deviceId, msgType == MsgType::Gps, output);
+    broadcastText(output, String("1:") + msgTypeName(msgType) + ":" + session->deviceId);
+
+    // Queue for Flask server; with fences loaded the server may only want the crossings
+    if (msgType == MsgType::Gps && !uplinkPositions())
+        return;
+    queueForFlask(doc);
+}
+
+// Dashboard asking for current state; "since" is the last version it saw
+void handleSubscribe(AsyncWebSocketClient *client, JsonDocument &doc, UserSession *, MsgType)
+{
+    client->text(buildSnapshotJson(doc["since"] | 0));
+}
+
+// Admin: replace the fence set and keep it in flash for the next boot
+void handleGeofenceSet(AsyncWebSocketClient *client, JsonDocument &doc, UserSession *, MsgType)
+{
+    if (!isAdmin(doc["token"] | ""))
+    {
+        sendReply(client, replyGeofenceUnauthorized);
+        return;
+    }
+
+    JsonArrayConst fences = doc["fences"].as<JsonArrayConst>();
+    size_t loaded = geofences.loadJson(fences);
+    for (auto &entry : activeSessions)
+        entry.second.fencesInside.clear(); // Indices refer to the old set
+
+    JsonDocument replyDoc;
+    replyDoc["type"] = "GEOFENCE_SET_RESULT";
+    replyDoc["count"] = loaded;
+
+    File file = LittleFS.open(GEOFENCE_FILE, "w");
+    if (file)
+    {
+        serializeJson(fences, file);
+        file.close();
+    }
+    else
+    {
+        replyDoc["error"] = "not persisted";
+    }
+
+    Serial.printf("Geofences replaced: %u loaded\n", (unsigned)loaded);
+
+    String replyMsg;
+    serializeJson(replyDoc, replyMsg);
+    client->text(replyMsg);
+}
+
+// Admin: CONFIG_GET returns the live config, CONFIG_SET changes it first
+void handleConfig(AsyncWebSocketClient *client, JsonDocument &doc, UserSession *, MsgType msgType)
+{
+    if (!isAdmin(doc["token"] | ""))
+    {
+        sendReply(client, replyConfigUnauthorized);
+        return;
+    }
+
+    JsonDocument replyDoc;
+    replyDoc["type"] = "CONFIG";
+    if (msgType == MsgType::ConfigSet)
+        updateRuntimeConfig(doc.as<JsonObjectConst>(), replyDoc["rejected"].to<JsonArray>());
+    ConfigStore::toJson(settings, replyDoc["values"].to<JsonObject>());
+
+    String replyMsg;
+    serializeJson(replyDoc, replyMsg);
+    client->text(replyMsg);
+}
+
+typedef void (*MsgHandler)(AsyncWebSocketClient *client, JsonDocument &doc, UserSession *session, MsgType type);
+
+struct MsgRoute
+{
+    MsgType type;
+    MsgHandler handler;
+    bool needsSession; // Drop the message unless the client has registered
+};
+
+// Indexed by MsgType; each entry names its type so a reordered enum or table
+// fails the build instead of misrouting messages
+constexpr MsgRoute MSG_ROUTES[] = {
+    {MsgType::Unknown, nullptr, false},
+    {MsgType::Register, handleRegister, false},
+    {MsgType::Resume, handleResume, false},
+    {MsgType::EnableSharing, handleEnableSharing, true},
+    {MsgType::TimePong, handleTimePong, true},
+    {MsgType::Gps, handleSensorData, true},
+    {MsgType::Imu, handleSensorData, true},
+    {MsgType::Subscribe, handleSubscribe, false},
+    {MsgType::GeofenceSet, handleGeofenceSet, false},
+    {MsgType::ConfigGet, handleConfig, false},
+    {MsgType::ConfigSet, handleConfig, false},
+};
+static_assert(sizeof(MSG_ROUTES) / sizeof(MSG_ROUTES[0]) == (size_t)MsgType::Count,
+              "MSG_ROUTES must have a route for every MsgType");
+
+constexpr bool routesInOrder(size_t i = 0)
+{
+    return i == (size_t)MsgType::Count || (MSG_ROUTES[i].type == (MsgType)i && routesInOrder(i + 1));
+}
+static_assert(routesInOrder(), "MSG_ROUTES[i] must be the route for MsgType i");
+
+// Message being reassembled from several WebSocket frames or TCP segments,
+// per client. Only touched from the async_tcp task (DATA and DISCONNECT).
+struct PartialMessage
+{
+    std::vector<char> data;
+    bool overflow = false; // Exceeded WS_MESSAGE_MAX; the rest is discarded
+};
+std::map<uint32_t, PartialMessage> partialMessages;
+
+// Parse one complete message and hand it to its route
+void dispatchMessage(AsyncWebSocketClient *client, const char *json, size_t len)
+{
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, json, len);
+
+    if (error)
+        return;
+
+    MsgType msgType = parseMsgType(doc["type"] | "");
+    const MsgRoute &route = MSG_ROUTES[(size_t)msgType];
+    if (!route.handler)
+        return;
+
+    std::lock_guard<std::recursive_mutex> lock(sessionLock);
+    UserSession *session = nullptr;
+    auto it = activeSessions.find(client->id());
+    if (it != activeSessions.end() && !it->second.superseded)
+        session = &it->second;
+    if (route.needsSession && !session)
+        return;
+
+    route.handler(client, doc, session, msgType);
 }
 
 void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
                AwsEventType type, void *arg, uint8_t *data, size_t len)
 {
+    TRACE_SCOPE("onWsEvent");
+
     if (type == WS_EVT_CONNECT)
     {
         Serial.printf("WebSocket client #%u connected\n", client->id());
+
+        std::lock_guard<std::mutex> lock(outboxLock);
+        outboxes[client->id()] = ClientOutbox();
     }
     else if (type == WS_EVT_DISCONNECT)
     {
-        if (activeSessions.count(client->id()))
         {
-            UserSession &session = activeSessions[client->id()];
-            session.disconnectPending = true;
-            session.disconnectTime = millis();
-
-            // Notify admin
-            JsonDocument alertDoc;
-            alertDoc["type"] = "USER_DISCONNECT";
-            alertDoc["username"] = session.username;
-            alertDoc["deviceId"] = session.deviceId;
-
-            String alertMsg;
-            serializeJson(alertDoc, alertMsg);
-            ws.textAll(alertMsg);
-
-            // Notify Flask Server about disconnection
-            queueForFlask(alertDoc);
+            std::lock_guard<std::mutex> lock(outboxLock);
+            outboxes.erase(client->id());
+        }
+        partialMessages.erase(client->id());
+
+        // USER_DISCONNECT goes out from loop() once the resume grace period passes
+        std::lock_guard<std::recursive_mutex> lock(sessionLock);
+        auto it = activeSessions.find(client->id());
+        if (it != activeSessions.end())
+        {
+            it->second.disconnectPending = true;
+            it->second.disconnectTime = millis();
         }
     }
     else if (type == WS_EVT_DATA)
     {
-        JsonDocument doc;
-        DeserializationError error = deserializeJson(doc, (const char *)data, len);
+        AwsFrameInfo *info = (AwsFrameInfo *)arg;
 
-        if (error)
+        // Sensor frames and control messages arrive whole
+        if (info->final && info->num == 0 && info->index == 0 && info->len == len)
+        {
+            dispatchMessage(client, (const char *)data, len);
             return;
+        }
 
-        String msgType = doc["type"] | "";
+        // A large message comes in pieces: TCP segments of one frame
+        // (index > 0) and/or continuation frames (num > 0)
+        PartialMessage &partial = partialMessages[client->id()];
+        if (info->num == 0 && info->index == 0)
+        {
+            partial.data.clear();
+            partial.overflow = false;
+            partial.data.reserve(min((size_t)info->len, WS_MESSAGE_MAX));
+        }
 
-        if (msgType == "REGISTER")
+        if (partial.overflow || partial.data.size() + len > WS_MESSAGE_MAX)
         {
-            UserSession session;
-            session.username = doc["username"].as<String>();
-            session.deviceId = doc["deviceId"].as<String>();
-            session.clientId = client->id();
-            session.lastSeen = millis();
-            session.dataSharingEnabled = false;
-            session.disconnectPending = false;
-
-            activeSessions[client->id()] = session;
-
-            // Send confirmation to the registering client
-            JsonDocument confirmDoc;
-            confirmDoc["type"] = "REGISTERED";
-            String confirmMsg;
-            serializeJson(confirmDoc, confirmMsg);
-            client->text(confirmMsg);
-
-            // Broadcast USER_CONNECTED to all other clients (dashboards)
-            JsonDocument notifyDoc;
-            notifyDoc["type"] = "USER_CONNECTED";
-            notifyDoc["username"] = session.username;
-            notifyDoc["deviceId"] = session.deviceId;
-            notifyDoc["clientId"] = session.clientId;
-            String notifyMsg;
-            serializeJson(notifyDoc, notifyMsg);
-            ws.textAll(notifyMsg);
-
-            Serial.printf("User registered: %s (%s)\n", session.username.c_str(), session.deviceId.c_str());
-
-            // Queue registration for Flask server
-            queueForFlask(notifyDoc);
+            if (!partial.overflow)
+                std::vector<char>().swap(partial.data); // Give the memory back now
+            partial.overflow = true;
         }
-        else if (msgType == "ENABLE_SHARING")
+        else
         {
-            if (activeSessions.count(client->id()))
-            {
-                bool enabled = doc["enabled"].as<bool>();
-                activeSessions[client->id()].dataSharingEnabled = enabled;
+            partial.data.insert(partial.data.end(), data, data + len);
+        }
 
-                Serial.printf("Data sharing %s for %s\n",
-                              enabled ? "enabled" : "disabled",
-                              activeSessions[client->id()].username.c_str());
-            }
+        if (!info->final || info->index + len < info->len)
+            return; // More of the message to come
+
+        if (partial.overflow)
+        {
+            Serial.printf("WebSocket client #%u: message over %u bytes dropped\n", client->id(),
+                          (unsigned)WS_MESSAGE_MAX);
+            sendReply(client, replyMessageTooLarge);
         }
-        else if (msgType == "GPS" || msgType == "IMU")
+        else
         {
-            if (activeSessions.count(client->id()))
-            {
-                UserSession &session = activeSessions[client->id()];
-                session.lastSeen = millis();
-
-                if (session.dataSharingEnabled)
-                {
-                    // Broadcast to local WebSocket clients
-                    String output;
-                    serializeJson(doc, output);
-                    ws.textAll(output);
-
-                    // Queue for Flask server
-                    queueForFlask(doc);
-                }
-            }
+            dispatchMessage(client, partial.data.data(), partial.data.size());
+        }
+        partialMessages.erase(client->id());
+    }
+}
+
+// Bridge health snapshot for /api/metrics
+String buildMetricsJson()
+{
+    JsonDocument doc;
+    doc["uptime"] = millis();
+    doc["freeHeap"] = ESP.getFreeHeap();
+    doc["sessions"] = sessionCount();
+    doc["flaskQueue"] = uplinkQueue.size();
+    doc["historyBytes"] = (uint32_t)HistoryStore::BYTES;
+
+    if (heapMonitor.samples.seq > 0)
+    {
+        const HeapSample &sample = heapMonitor.latest();
+        JsonObject heap = doc["heap"].to<JsonObject>();
+        heap["sampledAt"] = sample.t;
+        heap["free"] = sample.freeBytes;
+        heap["minFree"] = sample.minFree;
+        heap["largestBlock"] = sample.largest;
+        heap["allocations"] = sample.allocated;
+        heap["fragmentation"] = sample.fragmentation;
+        heap["trendPerHour"] = heapMonitor.trend;
+        heap["leakSuspected"] = heapMonitor.leakSuspected;
+    }
+
+    JsonObject uplink = doc["uplink"].to<JsonObject>();
+    uplink["batches"] = uplinkStats.batches;
+    uplink["records"] = uplinkStats.records;
+    uplink["rawBytes"] = uplinkStats.rawBytes;
+    uplink["wireBytes"] = uplinkStats.wireBytes;
+    uplink["ratio"] = uplinkStats.wireBytes ? (float)uplinkStats.rawBytes / uplinkStats.wireBytes : 1.0f;
+    uplink["compressMicros"] = uplinkStats.compressMicros;
+    uplink["maxCompressMicros"] = uplinkStats.maxCompressMicros;
+    uplink["latencyMs"] = uplinkStats.latencyMs;
+    uplink["dropped"] = uplinkStats.dropped;
+    uplink["pendingAttempts"] = uplinkQueue.attempts();
+
+    JsonArray endpoints = uplink["endpoints"].to<JsonArray>();
+    for (size_t i = 0; i < uplinkPool.size(); i++)
+    {
+        const UplinkEndpoint &ep = uplinkPool.endpoint(i);
+        JsonObject e = endpoints.add<JsonObject>();
+        e["url"] = ep.url;
+        e["state"] = ep.stateName();
+        e["failures"] = ep.failures;
+        e["backoff"] = ep.backoff;
+        e["sent"] = ep.sent;
+        e["failed"] = ep.failed;
+        e["latencyMs"] = ep.latencyMs;
+    }
+
+    JsonObject fusion = doc["fusion"].to<JsonObject>();
+    fusion["updates"] = fusionStats.updates;
+    fusion["avgCycles"] = fusionStats.updates ? (uint32_t)(fusionStats.cycles / fusionStats.updates) : 0;
+    fusion["maxCycles"] = fusionStats.maxCycles;
+    fusion["overBudget"] = fusionStats.overBudget;
+
+    JsonObject geofence = doc["geofence"].to<JsonObject>();
+    geofence["fences"] = geofences.size();
+    geofence["checks"] = geofenceStats.checks;
+    geofence["avgCycles"] = geofenceStats.checks ? (uint32_t)(geofenceStats.cycles / geofenceStats.checks) : 0;
+    geofence["maxCycles"] = geofenceStats.maxCycles;
+    geofence["events"] = geofenceStats.events;
+
+    JsonObject rate = doc["rate"].to<JsonObject>();
+    rate["level"] = rateController.level;
+    rate["pressure"] = rateController.pressure;
+    rate["gpsInterval"] = rateController.current().gpsInterval;
+    rate["imuInterval"] = rateController.current().imuInterval;
+
+    JsonArray clients = doc["clients"].to<JsonArray>();
+    {
+        std::lock_guard<std::mutex> lock(outboxLock);
+        unsigned long now = millis();
+        for (auto &entry : outboxes)
+        {
+            JsonObject c = clients.add<JsonObject>();
+            c["id"] = entry.first;
+            c["backlogBytes"] = entry.second.pendingBytes;
+            c["backlogMessages"] = entry.second.pending.size();
+            c["sent"] = entry.second.sent;
+            c["coalesced"] = entry.second.coalesced;
+            c["dropped"] = entry.second.dropped;
+            c["stalledMs"] = entry.second.stalledSince ? now - entry.second.stalledSince : 0;
         }
     }
+
+    String output;
+    serializeJson(doc, output);
+    return output;
 }
 
 void setup()
@@ -186,6 +1120,9 @@ void setup()
 
     Serial.println("\n\n=== ESP32 Starting ===");
 
+    // Before WiFi: the connect timeout is one of the stored settings
+    configStore.begin(settings);
+
     // Scan for visible networks
     Serial.println("Scanning for WiFi networks...");
     int n = WiFi.scanNetworks();
@@ -227,7 +1164,7 @@ void setup()
     WiFi.begin(HOME_WIFI_SSID, HOME_WIFI_PASSWORD);
 
     unsigned long startAttemptTime = millis();
-    while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < WIFI_TIMEOUT)
+    while (WiFi.status() != WL_CONNECTED && millis() - startAttemptTime < settings.wifiTimeout)
     {
         delay(500);
         Serial.print(".");
@@ -238,7 +1175,8 @@ void setup()
         Serial.println("\n✅ Connected to home WiFi!");
         Serial.print("Station IP: ");
         Serial.println(WiFi.localIP());
-        Serial.printf("Flask Server: http://%s:%d\n", FLASK_SERVER_IP, FLASK_SERVER_PORT);
+        for (size_t i = 0; i < FLASK_SERVER_COUNT; i++)
+            Serial.printf("Flask Server: http://%s\n", FLASK_SERVERS[i]);
     }
     else
     {
@@ -251,10 +1189,115 @@ void setup()
     Serial.printf("2. Password: %s\n", WIFI_PASSWORD);
     Serial.printf("3. Open browser: http://%s/\n", WiFi.softAPIP().toString().c_str());
 
+    uplinkPool.begin(FLASK_SERVERS, FLASK_SERVER_COUNT);
+
+    if (history.begin())
+        Serial.printf("History: %u bytes for %u devices (%s)\n", (unsigned)HistoryStore::BYTES,
+                      (unsigned)HISTORY_MAX_DEVICES, history.inPsram() ? "PSRAM" : "heap");
+    else
+        Serial.println("⚠️ History disabled: not enough memory");
+
+    // Fences survive reboots; GEOFENCE_SET overwrites the file
+    if (LittleFS.begin(true) && LittleFS.exists(GEOFENCE_FILE))
+    {
+        File file = LittleFS.open(GEOFENCE_FILE, "r");
+        JsonDocument fenceDoc;
+        if (file && !deserializeJson(fenceDoc, file))
+            Serial.printf("Geofences: %u loaded from %s\n",
+                          (unsigned)geofences.loadJson(fenceDoc.as<JsonArrayConst>()), GEOFENCE_FILE);
+        file.close();
+    }
+
+    pinReplies();
     ws.onEvent(onWsEvent);
     server.addHandler(&ws);
     server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
               { request->send(200, "text/html", index_html); });
+    server.on("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request)
+              { request->send(200, "application/json", buildMetricsJson()); });
+    server.on("/api/devices", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+                  uint32_t since = request->hasParam("since") ? request->getParam("since")->value().toInt() : 0;
+                  request->send(200, "application/json", buildSnapshotJson(since)); });
+    // /api/device/<id>/history?since=<bridge millis>, streamed straight from the ring
+    server.on("/api/device", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+                  String url = request->url();
+                  const String prefix = "/api/device/";
+                  const String suffix = "/history";
+                  if (!url.startsWith(prefix) || !url.endsWith(suffix))
+                  {
+                      request->send(404, "application/json", "{\"error\":\"not found\"}");
+                      return;
+                  }
+
+                  std::shared_ptr<HistoryCursor> cursor = std::make_shared<HistoryCursor>();
+                  cursor->deviceId = url.substring(prefix.length(), url.length() - suffix.length());
+                  cursor->since = request->hasParam("since") ? request->getParam("since")->value().toInt() : 0;
+                  if (!history.find(cursor->deviceId.c_str()))
+                  {
+                      request->send(404, "application/json", "{\"error\":\"no history for device\"}");
+                      return;
+                  }
+
+                  request->send(request->beginChunkedResponse(
+                      "application/json", [cursor](uint8_t *buffer, size_t maxLen, size_t index)
+                      { return historyFillJson(history, *cursor, buffer, maxLen); })); });
+    server.on("/api/heap", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+                  std::shared_ptr<HeapCursor> cursor = std::make_shared<HeapCursor>();
+                  request->send(request->beginChunkedResponse(
+                      "application/json", [cursor](uint8_t *buffer, size_t maxLen, size_t index)
+                      { return heapFillJson(heapMonitor, *cursor, buffer, maxLen); })); });
+    // GET: live config. POST with key=value parameters: change it (plus reset=true)
+    server.on("/api/config", HTTP_GET | HTTP_POST, [](AsyncWebServerRequest *request)
+              {
+                  String token = request->hasHeader("X-Admin-Token") ? request->header("X-Admin-Token")
+                                                                     : request->arg("token");
+                  if (!isAdmin(token.c_str()))
+                  {
+                      request->send(401, "application/json", "{\"error\":\"unauthorized\"}");
+                      return;
+                  }
+
+                  JsonDocument replyDoc;
+                  if (request->method() == HTTP_POST)
+                  {
+                      JsonDocument changeDoc;
+                      JsonObject values = changeDoc["values"].to<JsonObject>();
+                      for (size_t i = 0; i < request->params(); i++)
+                      {
+                          const AsyncWebParameter *param = request->getParam(i);
+                          const String &value = param->value();
+                          if (param->name() == "token")
+                              continue;
+                          if (param->name() == "reset")
+                              changeDoc["reset"] = value == "true" || value == "1";
+                          else if (value == "true" || value == "false")
+                              values[param->name()] = value == "true";
+                          else if (value.length() && strspn(value.c_str(), "0123456789") == value.length())
+                              values[param->name()] = (uint32_t)strtoul(value.c_str(), nullptr, 10);
+                          else
+                              values[param->name()] = value; // Rejected below
+                      }
+                      updateRuntimeConfig(changeDoc.as<JsonObjectConst>(), replyDoc["rejected"].to<JsonArray>());
+                  }
+                  ConfigStore::toJson(settings, replyDoc["values"].to<JsonObject>());
+
+                  String output;
+                  serializeJson(replyDoc, output);
+                  request->send(200, "application/json", output); });
+#ifdef ARTEMIS_TRACE
+    server.on("/api/trace", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+                  // Cursor lives as long as the response; streamed in chunks
+                  std::shared_ptr<TraceCursor> cursor = std::make_shared<TraceCursor>(traceBeginExport());
+                  AsyncWebServerResponse *response = request->beginChunkedResponse(
+                      "application/json", [cursor](uint8_t *buffer, size_t maxLen, size_t index)
+                      { return traceFillChromeJson(*cursor, buffer, maxLen); });
+                  response->addHeader("Content-Disposition", "attachment; filename=artemis-trace.json");
+                  request->send(response); });
+#endif
 
     server.begin();
     Serial.println("✅ WebSocket Server Started");
@@ -263,23 +1306,93 @@ void setup()
 
 void loop()
 {
-    ws.cleanupClients();
+    {
+        TRACE_SCOPE("cleanupClients");
+        ws.cleanupClients();
+    }
+    drainOutboxes();
+
+    // Process Flask queue (one batched POST per loop to avoid blocking).
+    // Nothing is sent while every server's circuit is open; records wait in
+    // the queue until one is due for a probe.
+    int endpoint = -1;
+    if (uplinkQueue.hasWork() && WiFi.status() == WL_CONNECTED)
+        endpoint = uplinkPool.pick(millis());
+
+    if (endpoint >= 0)
+    {
+        bool delivered = sendToFlaskServer(uplinkQueue.batch(settings.batchSize), endpoint);
+        bool dropped;
+        size_t settled = uplinkQueue.settle(delivered, settings.maxAttempts, dropped);
+        if (dropped)
+            uplinkStats.dropped += settled;
+        else
+            uplinkStats.records += settled;
+    }
+
+    if (configChanged)
+    {
+        configChanged = false;
+        applyRuntimeConfig();
+    }
+
+    if (millis() - lastRateEval > settings.rateEvalMs)
+    {
+        lastRateEval = millis();
+        updateSendRates();
+    }
 
-    // Process Flask queue (send one item per loop to avoid blocking)
-    if (!flaskQueue.empty() && WiFi.status() == WL_CONNECTED)
+    if (millis() - lastHeapSample >= HEAP_SAMPLE_INTERVAL)
     {
-        String data = flaskQueue.front();
-        flaskQueue.pop();
-        sendToFlaskServer(data);
+        lastHeapSample = millis();
+        HeapSample sample = heapMonitor.sample(lastHeapSample);
+        Serial.printf("Heap: free %u, min %u, largest %u, frag %u%%, allocs %u, trend %+.0f B/h (sessions %u, queue %u)\n",
+                      (unsigned)sample.freeBytes, (unsigned)sample.minFree, (unsigned)sample.largest,
+                      sample.fragmentation, (unsigned)sample.allocated, heapMonitor.trend,
+                      (unsigned)sessionCount(), (unsigned)uplinkQueue.size());
+        if (heapMonitor.leakSuspected)
+            Serial.printf("⚠️ Free heap shrinking by %.0f bytes/hour\n", -heapMonitor.trend);
     }
 
+    TRACE_SCOPE("sessionExpiry");
+    std::lock_guard<std::recursive_mutex> lock(sessionLock);
     unsigned long currentTime = millis();
     auto it = activeSessions.begin();
     while (it != activeSessions.end())
     {
-        if (it->second.disconnectPending && (currentTime - it->second.disconnectTime > DISCONNECT_TIMEOUT))
+        UserSession &session = it->second;
+        if (session.superseded)
+        {
+            it = activeSessions.erase(it);
+            continue;
+        }
+
+        if (!session.disconnectPending)
+        {
+            ClockSync &clock = session.clock;
+            unsigned long interval = clock.samples < CLOCK_SYNC_FAST_SAMPLES ? CLOCK_SYNC_FAST_INTERVAL : settings.clockSyncMs;
+            if (currentTime - clock.lastPing > interval)
+                sendClockPing(session);
+
+            // Only while the estimate beats the raw fixes; otherwise GPS frames carry the position
+            if (session.dataSharingEnabled && session.fusion.beatsFix() &&
+                currentTime - session.lastFused >= settings.fusedMs &&
+                (int32_t)(currentTime - session.fusion.lastFix) < (int32_t)FUSION_STALE_TIMEOUT)
+            {
+                session.lastFused = currentTime;
+                sendFused(session, currentTime);
+            }
+        }
+        else if (!session.offlineAnnounced && currentTime - session.disconnectTime > settings.resumeGrace)
+        {
+            announceDisconnected(session);
+        }
+
+        if (session.disconnectPending && (currentTime - session.disconnectTime > settings.disconnectMs))
         {
-            Serial.printf("Removing session for %s\n", it->second.username.c_str());
+            Serial.printf("Removing session for %s\n", session.username.c_str());
+            if (!session.offlineAnnounced)
+                announceDisconnected(session);
             it = activeSessions.erase(it); // Correct way to erase while iterating
         }
         else
@@ -0,0 +1,96 @@
+#ifndef MSG_ROUTER_H
+#define MSG_ROUTER_H
+
+#include <Arduino.h>
+
+// WebSocket message types understood by the bridge.
+// To add one: extend MsgType (before Count), add its name to MSG_TYPE_NAMES
+// and a case to parseMsgType(), then register a handler in main.cpp.
+enum class MsgType : uint8_t
+{
+    Unknown,
+    Register,
+    Resume,
+    EnableSharing,
+    TimePong,
+    Gps,
+    Imu,
+    Subscribe,
+    GeofenceSet,
+    ConfigGet,
+    ConfigSet,
+    Count
+};
+
+const char *const MSG_TYPE_NAMES[] = {
+    "",
+    "REGISTER",
+    "RESUME",
+    "ENABLE_SHARING",
+    "TIME_PONG",
+    "GPS",
+    "IMU",
+    "SUBSCRIBE",
+    "GEOFENCE_SET",
+    "CONFIG_GET",
+    "CONFIG_SET",
+};
+static_assert(sizeof(MSG_TYPE_NAMES) / sizeof(MSG_TYPE_NAMES[0]) == (size_t)MsgType::Count,
+              "MSG_TYPE_NAMES must list every MsgType");
+
+// FNV-1a, usable in case labels so the switch below is resolved at compile
+// time and a hash collision between two type names fails the build
+constexpr uint32_t msgHash(const char *s, uint32_t h = 2166136261u)
+{
+    return *s ? msgHash(s + 1, (h ^ (uint8_t)*s) * 16777619u) : h;
+}
+
+inline const char *msgTypeName(MsgType type)
+{
+    return MSG_TYPE_NAMES[(size_t)type];
+}
+
+// Map the "type" field to a MsgType without allocating. The final strcmp
+// rejects unknown strings that happen to share a hash with a known type.
+inline MsgType parseMsgType(const char *name)
+{
+    MsgType type;
+    switch (msgHash(name))
+    {
+    case msgHash("REGISTER"):
+        type = MsgType::Register;
+        break;
+    case msgHash("RESUME"):
+        type = MsgType::Resume;
+        break;
+    case msgHash("ENABLE_SHARING"):
+        type = MsgType::EnableSharing;
+        break;
+    case msgHash("TIME_PONG"):
+        type = MsgType::TimePong;
+        break;
+    case msgHash("GPS"):
+        type = MsgType::Gps;
+        break;
+    case msgHash("IMU"):
+        type = MsgType::Imu;
+        break;
+    case msgHash("SUBSCRIBE"):
+        type = MsgType::Subscribe;
+        break;
+    case msgHash("GEOFENCE_SET"):
+        type = MsgType::GeofenceSet;
+        break;
+    case msgHash("CONFIG_GET"):
+        type = MsgType::ConfigGet;
+        break;
+    case msgHash("CONFIG_SET"):
+        type = MsgType::ConfigSet;
+        break;
+    default:
+        return MsgType::Unknown;
+    }
+    return strcmp(name, msgTypeName(type)) == 0 ? type : MsgType::Unknown;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef RATE_CONTROL_H
+#define RATE_CONTROL_H
+
+#include <Arduino.h>
+
+// Closed-loop send rate control for the phones.
+// The bridge folds uplink queue fill, uplink latency and session count into
+// one pressure value (1.0 = at capacity) and steps through RATE_LEVELS with
+// hysteresis: slow down above RATE_PRESSURE_HIGH, speed up below
+// RATE_PRESSURE_LOW, and never change more than once per RATE_HOLD_TIME.
+// minLevel/maxLevel narrow the range at runtime; equal bounds pin the rate.
+struct RateLevel
+{
+    uint16_t gpsInterval; // ms between GPS frames
+    uint16_t imuInterval; // ms between IMU frames
+};
+
+const RateLevel RATE_LEVELS[] = {
+    {1000, 500},  // Boost: plenty of headroom
+    {2000, 1000}, // Normal (the user app's built-in defaults)
+    {4000, 2000}, // Reduced
+    {8000, 5000}, // Minimal: uplink saturated
+};
+const uint8_t RATE_LEVEL_COUNT = sizeof(RATE_LEVELS) / sizeof(RATE_LEVELS[0]);
+const uint8_t RATE_LEVEL_DEFAULT = 1;
+
+const float RATE_PRESSURE_HIGH = 0.75f;
+const float RATE_PRESSURE_LOW = 0.25f;
+const unsigned long RATE_HOLD_TIME = 5000;
+
+struct RateController
+{
+    uint8_t level = RATE_LEVEL_DEFAULT;
+    float pressure = 0;
+    unsigned long lastChange = 0;
+    uint8_t minLevel = 0;
+    uint8_t maxLevel = RATE_LEVEL_COUNT - 1;
+
+    const RateLevel &current() const { return RATE_LEVELS[level]; }
+
+    // Feed the latest pressure; returns true if the level changed and the
+    // new rate should be pushed to every session
+    bool update(float newPressure, unsigned long now)
+    {
+        pressure = newPressure;
+
+        // Bounds moved past the current level: follow them without waiting
+        uint8_t target = constrain(level, minLevel, maxLevel);
+        if (target == level)
+        {
+            if (now - lastChange < RATE_HOLD_TIME)
+                return false;
+
+            if (pressure > RATE_PRESSURE_HIGH && level < maxLevel)
+                target = level + 1;
+            else if (pressure < RATE_PRESSURE_LOW && level > minLevel)
+                target = level - 1;
+        }
+
+        if (target == level)
+            return false;
+
+        level = target;
+        lastChange = now;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef RUNTIME_CONFIG_H
+#define RUNTIME_CONFIG_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+
+// Throughput knobs that can be changed on a running bridge. The constants
+// in config.h are the defaults; values set through the admin interface are
+// written to NVS (namespace "artemis") and override them from the next boot
+// on. Each knob is listed once in CONFIG_FIELDS with its key and range, and
+// that table drives loading, validation and the JSON view.
+struct RuntimeConfig
+{
+    // Uplink
+    uint32_t queueSize;      // Records held for Flask (FLASK_QUEUE_SIZE)
+    uint32_t batchSize;      // Records per POST
+    uint32_t compress;       // Deflate batches, 0/1
+    uint32_t compressMin;    // Smallest batch worth compressing, bytes
+    uint32_t httpTimeout;    // Per POST, ms
+    uint32_t connectTimeout; // TCP connect, ms
+    uint32_t maxAttempts;    // Servers a batch is tried on
+    uint32_t geoEventsOnly;  // Forward only geofence crossings, not GPS or FUSED positions, 0/1
+
+    // Sessions
+    uint32_t disconnectMs; // Session kept this long after its socket drops
+    uint32_t resumeGrace;  // USER_DISCONNECT held back this long
+    uint32_t wifiTimeout;  // Home WiFi connect at boot, ms
+    uint32_t clockSyncMs;  // Steady-state TIME_PING interval
+    uint32_t fusedMs;      // FUSED output interval per session
+
+    // Send rates
+    uint32_t rateEvalMs;    // Pressure re-evaluation interval
+    uint32_t rateMinLevel;  // Fastest level the controller may pick (index into RATE_LEVELS)
+    uint32_t rateMaxLevel;  // Slowest level; min == max pins the rate
+    uint32_t latencyTarget; // POST latency treated as full load, ms
+    uint32_t sessionBudget; // Sharing sessions treated as full load
+
+    // Dashboards
+    uint32_t backlogBudget; // Bytes held back per slow WebSocket client
+    uint32_t stallTimeout;  // Close clients stuck with a backlog this long, ms
+};
+
+struct ConfigField
+{
+    const char *key; // JSON name and NVS key (NVS allows at most 15 characters)
+    uint32_t RuntimeConfig::*value;
+    uint32_t defaultValue;
+    uint32_t minValue;
+    uint32_t maxValue;
+    bool isBool;
+};
+
+const ConfigField CONFIG_FIELDS[] = {
+    {"queueSize", &RuntimeConfig::queueSize, FLASK_QUEUE_SIZE, 1, 200, false},
+    {"batchSize", &RuntimeConfig::batchSize, UPLINK_BATCH_SIZE, 1, 64, false},
+    {"compress", &RuntimeConfig::compress, UPLINK_COMPRESSION, 0, 1, true},
+    {"compressMin", &RuntimeConfig::compressMin, UPLINK_COMPRESS_MIN_BYTES, 0, 65535, false},
+    {"httpTimeout", &RuntimeConfig::httpTimeout, UPLINK_HTTP_TIMEOUT, 100, 30000, false},
+    {"connectTimeout", &RuntimeConfig::connectTimeout, (uint32_t)UPLINK_CONNECT_TIMEOUT, 100, 30000, false},
+    {"maxAttempts", &RuntimeConfig::maxAttempts, UPLINK_MAX_ATTEMPTS, 1, 16, false},
+    {"geoEventsOnly", &RuntimeConfig::geoEventsOnly, GEOFENCE_UPLINK_EVENTS_ONLY, 0, 1, true},
+    {"disconnectMs", &RuntimeConfig::disconnectMs, DISCONNECT_TIMEOUT, 5000, 3600000, false},
+    {"resumeGrace", &RuntimeConfig::resumeGrace, RESUME_GRACE_PERIOD, 0, 600000, false},
+    {"wifiTimeout", &RuntimeConfig::wifiTimeout, WIFI_TIMEOUT, 1000, 120000, false},
+    {"clockSyncMs", &RuntimeConfig::clockSyncMs, CLOCK_SYNC_INTERVAL, 1000, 600000, false},
+    {"fusedMs", &RuntimeConfig::fusedMs, FUSION_OUTPUT_INTERVAL, 100, 60000, false},
+    {"rateEvalMs", &RuntimeConfig::rateEvalMs, RATE_EVAL_INTERVAL, 100, 60000, false},
+    {"rateMinLevel", &RuntimeConfig::rateMinLevel, 0, 0, RATE_LEVEL_COUNT - 1, false},
+    {"rateMaxLevel", &RuntimeConfig::rateMaxLevel, RATE_LEVEL_COUNT - 1, 0, RATE_LEVEL_COUNT - 1, false},
+    {"latencyTarget", &RuntimeConfig::latencyTarget, RATE_LATENCY_TARGET, 10, 60000, false},
+    {"sessionBudget", &RuntimeConfig::sessionBudget, RATE_SESSION_BUDGET, 1, 256, false},
+    {"backlogBudget", &RuntimeConfig::backlogBudget, CLIENT_BACKLOG_BUDGET, 1024, 262144, false},
+    {"stallTimeout", &RuntimeConfig::stallTimeout, CLIENT_STALL_TIMEOUT, 1000, 600000, false},
+};
+const size_t CONFIG_FIELD_COUNT = sizeof(CONFIG_FIELDS) / sizeof(CONFIG_FIELDS[0]);
+
+class ConfigStore
+{
+public:
+    // Defaults overlaid with whatever was saved to NVS
+    void begin(RuntimeConfig &config)
+    {
+        _prefs.begin("artemis", false);
+        for (const ConfigField &field : CONFIG_FIELDS)
+        {
+            uint32_t value = _prefs.getUInt(field.key, field.defaultValue);
+            config.*field.value = constrain(value, field.minValue, field.maxValue);
+        }
+    }
+
+    static const ConfigField *find(const char *key)
+    {
+        for (const ConfigField &field : CONFIG_FIELDS)
+        {
+            if (strcmp(field.key, key) == 0)
+                return &field;
+        }
+        return nullptr;
+    }
+
+    // Validate, apply and persist one value. Returns false (and changes
+    // nothing) for unknown keys, wrong types and out-of-range values.
+    bool set(RuntimeConfig &config, const char *key, JsonVariantConst value)
+    {
+        const ConfigField *field = find(key);
+        if (!field)
+            return false;
+
+        uint32_t v;
+        if (field->isBool && value.is<bool>())
+            v = value.as<bool>() ? 1 : 0;
+        else if (value.is<uint32_t>())
+            v = value.as<uint32_t>();
+        else
+            return false;
+
+        if (v < field->minValue || v > field->maxValue)
+            return false;
+
+        config.*field->value = v;
+        if (v == field->defaultValue)
+            _prefs.remove(field->key); // Back on the default: follow config.h from now on
+        else
+            _prefs.putUInt(field->key, v);
+        return true;
+    }
+
+    // Forget every override
+    void reset(RuntimeConfig &config)
+    {
+        _prefs.clear();
+        for (const ConfigField &field : CONFIG_FIELDS)
+            config.*field.value = field.defaultValue;
+    }
+
+    static void toJson(const RuntimeConfig &config, JsonObject out)
+    {
+        for (const ConfigField &field : CONFIG_FIELDS)
+        {
+            if (field.isBool)
+                out[field.key] = config.*field.value != 0;
+            else
+                out[field.key] = config.*field.value;
+        }
+    }
+
+private:
+    Preferences _prefs;
+};
+
+#endif
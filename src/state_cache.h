@@ -0,0 +1,87 @@
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include <Arduino.h>
+#include <map>
+
+// Versioned last-known state per device, so a dashboard joining the AP can
+// fetch a snapshot from the bridge instead of the Flask server, then follow
+// live deltas tagged with "v". Every change takes the next global version;
+// a reconnecting dashboard asks for "since N" and gets only the devices whose
+// version is newer. Offline devices stay as tombstones until evicted, and
+// once anything newer than a client's N has been evicted it gets a full
+// snapshot instead.
+struct DeviceState
+{
+    String username;
+    bool online = false;
+    String gps; // Last GPS frame as sent to dashboards (raw JSON)
+    String imu; // Last IMU frame
+    uint32_t version = 0;
+};
+
+class StateCache
+{
+public:
+    static const size_t MAX_DEVICES = 32;
+
+    std::map<String, DeviceState> devices;
+    uint32_t version = 0;        // Latest version handed out
+    uint32_t evictedVersion = 0; // Newest version dropped by eviction
+
+    // Record a presence change; returns the version to tag the delta with
+    uint32_t setOnline(const String &deviceId, const String &username, bool online)
+    {
+        DeviceState &state = touch(deviceId);
+        state.username = username;
+        state.online = online;
+        return state.version;
+    }
+
+    // Keep the latest serialized frame; call after setOnline() reserved its version
+    void storeFrame(const String &deviceId, bool isGps, const String &json)
+    {
+        auto it = devices.find(deviceId);
+        if (it == devices.end())
+            return;
+        (isGps ? it->second.gps : it->second.imu) = json;
+    }
+
+    // Whether a client that has seen everything up to `since` needs a full snapshot
+    bool needsFull(uint32_t since) const
+    {
+        return since == 0 || since < evictedVersion || since > version;
+    }
+
+private:
+    DeviceState &touch(const String &deviceId)
+    {
+        if (!devices.count(deviceId) && devices.size() >= MAX_DEVICES)
+            evictOldest();
+
+        DeviceState &state = devices[deviceId];
+        state.version = ++version;
+        return state;
+    }
+
+    // Drop the least recently changed device, preferring offline ones
+    void evictOldest()
+    {
+        auto victim = devices.end();
+        for (auto it = devices.begin(); it != devices.end(); ++it)
+        {
+            if (victim == devices.end() ||
+                (victim->second.online && !it->second.online) ||
+                (victim->second.online == it->second.online && it->second.version < victim->second.version))
+                victim = it;
+        }
+        if (victim != devices.end())
+        {
+            if (victim->second.version > evictedVersion)
+                evictedVersion = victim->second.version;
+            devices.erase(victim);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Lightweight timeline tracing. Build with -DARTEMIS_TRACE (see
+// platformio.ini) to record TRACE_SCOPE("name") blocks into a fixed RAM
+// ring and serve them from /api/trace in Chrome trace-event format
+// (open the file in https://ui.perfetto.dev). Without the flag every
+// TRACE_SCOPE compiles to nothing.
+
+#ifdef ARTEMIS_TRACE
+
+#include <Arduino.h>
+#include "chunk_stage.h"
+
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 512 // Events kept (16 bytes each)
+#endif
+
+// One complete ("X") event: a scope's start and duration, so a wrapped ring
+// never leaves a begin without its end
+struct TraceEvent
+{
+    const char *name; // Must be a string literal
+    uint32_t ts;      // esp_timer microseconds (wraps after ~71 minutes)
+    uint32_t dur;
+    uint8_t core;
+};
+
+TraceEvent traceRing[TRACE_BUFFER_SIZE];
+volatile uint32_t traceSeq = 0; // Total events ever written
+portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+
+void traceRecord(const char *name, uint32_t start, uint32_t dur)
+{
+    portENTER_CRITICAL(&traceMux);
+    TraceEvent &ev = traceRing[traceSeq % TRACE_BUFFER_SIZE];
+    ev.name = name;
+    ev.ts = start;
+    ev.dur = dur;
+    ev.core = xPortGetCoreID();
+    traceSeq++;
+    portEXIT_CRITICAL(&traceMux);
+}
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) : _name(name), _start((uint32_t)esp_timer_get_time()) {}
+    ~TraceScope() { traceRecord(_name, _start, (uint32_t)esp_timer_get_time() - _start); }
+
+private:
+    const char *_name;
+    uint32_t _start;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(_traceScope, __LINE__)(name)
+
+// Streaming state for one /api/trace response
+struct TraceCursor
+{
+    uint32_t next;     // Sequence number of the next event to write
+    uint32_t end;      // Events recorded after the request started are left out
+    uint8_t stage = 0; // 0 = header, 1 = events, 2 = footer, 3 = done
+    bool first = true;
+    ChunkStage out;
+};
+
+inline TraceCursor traceBeginExport()
+{
+    TraceCursor cursor;
+    cursor.end = traceSeq;
+    cursor.next = cursor.end > TRACE_BUFFER_SIZE ? cursor.end - TRACE_BUFFER_SIZE : 0;
+    return cursor;
+}
+
+// Fill `buffer` with the next piece of the trace JSON; returns 0 when done.
+// Suited to AsyncWebServerRequest::beginChunkedResponse, so the full trace
+// is never held in memory.
+size_t traceFillChromeJson(TraceCursor &cursor, uint8_t *buffer, size_t maxLen)
+{
+    char *out = (char *)buffer;
+    size_t len = cursor.out.drain(out, maxLen);
+
+    while (len < maxLen && cursor.stage < 3)
+    {
+        switch (cursor.stage)
+        {
+        case 0:
+            cursor.out.format("{\"traceEvents\":[");
+            cursor.stage = 1;
+            break;
+
+        case 1:
+        {
+            // The writer may have lapped us while streaming; skip what it overwrote
+            uint32_t oldest = traceSeq > TRACE_BUFFER_SIZE ? traceSeq - TRACE_BUFFER_SIZE : 0;
+            if (cursor.next < oldest)
+                cursor.next = oldest;
+            if (cursor.next >= cursor.end)
+            {
+                cursor.stage = 2;
+                break;
+            }
+
+            portENTER_CRITICAL(&traceMux);
+            TraceEvent ev = traceRing[cursor.next % TRACE_BUFFER_SIZE];
+            portEXIT_CRITICAL(&traceMux);
+
+            cursor.out.format("%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%u,\"dur\":%u,\"pid\":1,\"tid\":%u}",
+                              cursor.first ? "" : ",", ev.name, (unsigned)ev.ts, (unsigned)ev.dur,
+                              (unsigned)ev.core);
+            cursor.next++;
+            cursor.first = false;
+            break;
+        }
+
+        case 2:
+            cursor.out.format("],\"displayTimeUnit\":\"ms\"}");
+            cursor.stage = 3;
+            break;
+        }
+        len += cursor.out.drain(out + len, maxLen - len);
+    }
+
+    return len;
+}
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef UPLINK_POOL_H
+#define UPLINK_POOL_H
+
+#include <Arduino.h>
+#include <vector>
+
+// Health tracking for the upstream Flask servers. Each endpoint has a
+// circuit breaker: after UPLINK_FAILURE_THRESHOLD failures in a row it
+// opens and is skipped, so a dead server no longer costs a full HTTP
+// timeout per batch. Once its backoff expires one batch is let through as
+// a probe (half-open); success closes the circuit, failure re-opens it with
+// the backoff doubled up to UPLINK_BACKOFF_MAX. Healthy endpoints take
+// batches in turn. Time is passed in, so the logic runs unchanged on a host.
+struct UplinkEndpoint
+{
+    enum State : uint8_t
+    {
+        Closed,   // Healthy, takes batches
+        Open,     // Failing, skipped until retryAt
+        HalfOpen, // Probe in flight
+    };
+
+    String url;
+    State state = Closed;
+    uint8_t failures = 0; // Consecutive
+    uint32_t backoff = 0; // Current open period, ms
+    uint32_t retryAt = 0; // millis() when an open circuit may be probed
+    float latencyMs = 0;  // Smoothed POST round trip
+    uint32_t sent = 0;
+    uint32_t failed = 0;
+
+    const char *stateName() const
+    {
+        return state == Closed ? "closed" : state == Open ? "open" : "half-open";
+    }
+};
+
+class UplinkPool
+{
+public:
+    // hosts are "ip:port"
+    void begin(const char *const *hosts, size_t count)
+    {
+        _endpoints.clear();
+        for (size_t i = 0; i < count; i++)
+        {
+            UplinkEndpoint ep;
+            ep.url = String("http://") + hosts[i] + "/api/esp32/data";
+            _endpoints.push_back(ep);
+        }
+        _next = 0;
+    }
+
+    size_t size() const { return _endpoints.size(); }
+    UplinkEndpoint &endpoint(size_t i) { return _endpoints[i]; }
+
+    // Endpoint for the next batch, or -1 when every circuit is open and none
+    // is due for a probe (the caller should hold the batch and try later).
+    // Probes win over round-robin so a recovered server is noticed quickly.
+    int pick(uint32_t now)
+    {
+        for (size_t i = 0; i < _endpoints.size(); i++)
+        {
+            UplinkEndpoint &ep = _endpoints[i];
+            if (ep.state == UplinkEndpoint::Open && (int32_t)(now - ep.retryAt) >= 0)
+            {
+                ep.state = UplinkEndpoint::HalfOpen;
+                return i;
+            }
+        }
+
+        for (size_t n = 0; n < _endpoints.size(); n++)
+        {
+            size_t i = (_next + n) % _endpoints.size();
+            if (_endpoints[i].state == UplinkEndpoint::Closed)
+            {
+                _next = i + 1;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void report(int index, bool ok, uint32_t latency, uint32_t now)
+    {
+        UplinkEndpoint &ep = _endpoints[index];
+        ep.latencyMs += ((float)latency - ep.latencyMs) / 8;
+
+        if (ok)
+        {
+            ep.sent++;
+            ep.failures = 0;
+            ep.backoff = 0;
+            ep.state = UplinkEndpoint::Closed;
+            return;
+        }
+
+        ep.failed++;
+        if (ep.failures < 255)
+            ep.failures++;
+
+        if (ep.state == UplinkEndpoint::HalfOpen || ep.failures >= UPLINK_FAILURE_THRESHOLD)
+        {
+            ep.backoff = ep.backoff ? min(ep.backoff * 2, (uint32_t)UPLINK_BACKOFF_MAX) : (uint32_t)UPLINK_BACKOFF_MIN;
+            ep.retryAt = now + ep.backoff;
+            ep.state = UplinkEndpoint::Open;
+        }
+    }
+
+    // The batch picked for `index` was never sent (e.g. WiFi dropped in
+    // between), so nothing was learned about the server. A probe slot goes
+    // back to open with its retry time already due, to be probed again.
+    void release(int index)
+    {
+        UplinkEndpoint &ep = _endpoints[index];
+        if (ep.state == UplinkEndpoint::HalfOpen)
+            ep.state = UplinkEndpoint::Open;
+    }
+
+    size_t healthy() const
+    {
+        size_t count = 0;
+        for (const UplinkEndpoint &ep : _endpoints)
+        {
+            if (ep.state == UplinkEndpoint::Closed)
+                count++;
+        }
+        return count;
+    }
+
+private:
+    std::vector<UplinkEndpoint> _endpoints;
+    size_t _next = 0;
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef UPLINK_QUEUE_H
+#define UPLINK_QUEUE_H
+
+#include <Arduino.h>
+#include <deque>
+#include <mutex>
+
+// Records waiting for the Flask servers, and the batch being delivered.
+// Records are pushed from the WebSocket handlers (async_tcp task) and from
+// loop(); only loop() takes and settles batches. The lock covers the queue
+// itself and is never held across an HTTP POST.
+class UplinkQueue
+{
+public:
+    // Keep a serialized record; dropped (false) when `limit` are waiting
+    bool push(String record, size_t limit)
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        if (_records.size() >= limit)
+            return false;
+        _records.push_back(std::move(record));
+        return true;
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _records.size();
+    }
+
+    // Drop the oldest records down to `limit`; returns how many went
+    size_t trim(size_t limit)
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        size_t dropped = 0;
+        while (_records.size() > limit)
+        {
+            _records.pop_front();
+            dropped++;
+        }
+        return dropped;
+    }
+
+    // Anything to send: a batch still being retried, or queued records
+    bool hasWork()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _batch.length() || !_records.empty();
+    }
+
+    // The batch to send next, as a JSON array. A batch that failed is kept
+    // and returned again, so it moves on to the next server; otherwise up to
+    // maxRecords are taken off the queue into a buffer sized in one go.
+    const String &batch(size_t maxRecords)
+    {
+        if (_batch.length())
+            return _batch;
+
+        std::lock_guard<std::mutex> lock(_lock);
+        size_t count = min(maxRecords, _records.size());
+        size_t bytes = count + 1; // Brackets and commas
+        for (size_t i = 0; i < count; i++)
+            bytes += _records[i].length();
+
+        _batch.reserve(bytes);
+        _batch = "[";
+        for (size_t i = 0; i < count; i++)
+        {
+            if (i > 0)
+                _batch += ',';
+            _batch += _records.front();
+            _records.pop_front();
+        }
+        _batch += ']';
+        _batchRecords = count;
+        _attempts = 0;
+        return _batch;
+    }
+
+    // Outcome of one attempt at the current batch. Returns how many records
+    // it settled: delivered, or given up on after maxAttempts (`dropped` is
+    // set then); 0 while the batch is kept for another attempt.
+    size_t settle(bool delivered, uint32_t maxAttempts, bool &dropped)
+    {
+        dropped = false;
+        if (!delivered && ++_attempts < maxAttempts)
+            return 0;
+
+        dropped = !delivered;
+        size_t records = _batchRecords;
+        _batch = String(); // Release the buffer
+        _batchRecords = 0;
+        return records;
+    }
+
+    uint8_t attempts() const { return _attempts; }
+
+private:
+    std::mutex _lock;
+    std::deque<String> _records;
+
+    // Only loop() touches the batch
+    String _batch;
+    size_t _batchRecords = 0;
+    uint8_t _attempts = 0;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef WS_OUTBOX_H
+#define WS_OUTBOX_H
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+
+// Per-client outbound backlog for dashboard WebSocket clients.
+// Messages are only held here when the client's AsyncWebSocket queue is full;
+// each one carries a coalesce key so a slow viewer keeps just the newest
+// state per device instead of an ever-growing queue. Keys prefixed "0:" are
+// presence/control and sort (and drain) ahead of "1:" telemetry.
+// A broadcast that backs up several clients parks the same immutable copy in
+// each of their outboxes rather than one String per client.
+typedef std::shared_ptr<const String> ParkedText;
+
+struct ClientOutbox
+{
+    std::map<String, ParkedText> pending; // coalesce key -> newest message
+    size_t pendingBytes = 0;
+    unsigned long stalledSince = 0; // millis() when the backlog became non-empty, 0 if empty
+    uint32_t sent = 0;
+    uint32_t coalesced = 0; // messages replaced by a newer one with the same key
+    uint32_t dropped = 0;   // telemetry discarded to stay within the byte budget
+
+    void defer(const String &key, const ParkedText &msg)
+    {
+        auto it = pending.find(key);
+        if (it != pending.end())
+        {
+            pendingBytes -= it->second->length();
+            it->second = msg;
+            coalesced++;
+        }
+        else
+        {
+            pending[key] = msg;
+        }
+        pendingBytes += msg->length();
+
+        if (stalledSince == 0)
+            stalledSince = millis() | 1;
+    }
+
+    // Drop telemetry (never presence) until the backlog fits the budget
+    void trimTo(size_t budget)
+    {
+        auto it = pending.lower_bound("1:");
+        while (pendingBytes > budget && it != pending.end())
+        {
+            pendingBytes -= it->second->length();
+            it = pending.erase(it);
+            dropped++;
+        }
+    }
+
+    // Remove the first pending message after it was handed to the client
+    void popFront()
+    {
+        auto it = pending.begin();
+        pendingBytes -= it->second->length();
+        pending.erase(it);
+        sent++;
+        if (pending.empty())
+            stalledSince = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef ARDUINO_HOST_SHIM_H
+#define ARDUINO_HOST_SHIM_H
+
+// Just enough of the Arduino core for the header-only modules in src/ to
+// build and run on a PC ([env:native]). String sits on std::string, so all
+// of its memory goes through operator new; millis() is a simulated clock
+// the tests move forward themselves. The few FreeRTOS/ESP-IDF calls the
+// modules make are single-task stand-ins.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+
+using std::max;
+using std::min;
+
+#define PI 3.1415926535897932384626433832795
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+class String
+{
+public:
+    String() {}
+    String(const char *s) : _s(s ? s : "") {}
+    String(const std::string &s) : _s(s) {}
+    explicit String(char c) : _s(1, c) {}
+    explicit String(int v) : _s(std::to_string(v)) {}
+    explicit String(unsigned int v) : _s(std::to_string(v)) {}
+    explicit String(long v) : _s(std::to_string(v)) {}
+    explicit String(unsigned long v) : _s(std::to_string(v)) {}
+
+    const char *c_str() const { return _s.c_str(); }
+    unsigned int length() const { return _s.size(); }
+    bool reserve(unsigned int size)
+    {
+        _s.reserve(size);
+        return true;
+    }
+
+    bool concat(const char *s)
+    {
+        _s += s;
+        return true;
+    }
+    bool concat(const char *s, unsigned int len)
+    {
+        _s.append(s, len);
+        return true;
+    }
+    String &operator+=(const String &s)
+    {
+        _s += s._s;
+        return *this;
+    }
+    String &operator+=(const char *s)
+    {
+        _s += s;
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        _s += c;
+        return *this;
+    }
+
+    bool operator==(const String &s) const { return _s == s._s; }
+    bool operator==(const char *s) const { return _s == s; }
+    bool operator!=(const String &s) const { return _s != s._s; }
+    bool operator<(const String &s) const { return _s < s._s; }
+    char operator[](unsigned int i) const { return _s[i]; }
+
+    bool startsWith(const String &prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+
+private:
+    std::string _s;
+};
+
+inline String operator+(const String &a, const String &b)
+{
+    String out(a);
+    out += b;
+    return out;
+}
+
+inline String operator+(const String &a, const char *b)
+{
+    String out(a);
+    out += b;
+    return out;
+}
+
+inline String operator+(const char *a, const String &b)
+{
+    String out(a);
+    out += b;
+    return out;
+}
+
+// ====== Time ======
+inline unsigned long &hostMillis()
+{
+    static unsigned long now = 0;
+    return now;
+}
+inline unsigned long millis() { return hostMillis(); }
+inline unsigned long micros() { return hostMillis() * 1000; }
+
+// ====== FreeRTOS / ESP-IDF ======
+// One task on one core: critical sections have nothing to exclude
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+inline int xPortGetCoreID() { return 0; }
+inline int64_t esp_timer_get_time() { return (int64_t)micros(); }
+
+// ====== Memory ======
+inline bool psramFound() { return false; }
+inline void *ps_malloc(size_t size) { return malloc(size); }
+
+// Not in every C library; a macro so it cannot clash with one that has it
+inline size_t arduinoStrlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size)
+    {
+        size_t n = min(len, size - 1);
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#define strlcpy arduinoStrlcpy
+
+#endif
@@ -0,0 +1,132 @@
+// The chunked JSON writers behind /api/device/<id>/history and /api/trace:
+// whatever the chunk size AsyncWebServer asks for, each call writes at most
+// that many bytes, the chunks add up to exactly the one-shot output, and 0
+// comes back only once the closing brace is out
+
+#define ARTEMIS_TRACE
+#include <Arduino.h>
+#include <unity.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include "config.h"
+#include "history_ring.h"
+#include "trace.h"
+
+const size_t MAX_CHUNK = 4096;
+const size_t GUARD = 16;
+const uint8_t CANARY = 0xA5;
+
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen)> Fill;
+
+// Run a stream to the end in `maxLen` chunks, failing on any overrun or a
+// 0 before the end; returns what it wrote
+std::string drain(Fill fill, size_t maxLen)
+{
+    std::string out;
+    uint8_t buffer[MAX_CHUNK + GUARD];
+    for (;;)
+    {
+        memset(buffer, CANARY, sizeof(buffer));
+        size_t n = fill(buffer, maxLen);
+        TEST_ASSERT_LESS_OR_EQUAL(maxLen, n);
+        for (size_t i = maxLen; i < maxLen + GUARD; i++)
+            TEST_ASSERT_EQUAL_HEX8(CANARY, buffer[i]);
+        if (n == 0)
+            break;
+        out.append((const char *)buffer, n);
+        TEST_ASSERT_LESS_THAN(1 << 20, out.size()); // Would never end
+    }
+    TEST_ASSERT_EQUAL(0, fill(buffer, maxLen)); // Stays done
+    return out;
+}
+
+// Every chunk size from 1 byte up, then a few large ones
+void checkAllChunkSizes(std::function<Fill()> start)
+{
+    std::string whole = drain(start(), MAX_CHUNK);
+    TEST_ASSERT_GREATER_THAN(2, whole.size());
+    TEST_ASSERT_EQUAL('{', whole.front());
+    TEST_ASSERT_EQUAL('}', whole.back());
+
+    for (size_t maxLen = 1; maxLen <= MAX_CHUNK; maxLen += maxLen < 600 ? 1 : 97)
+    {
+        std::string chunked = drain(start(), maxLen);
+        if (chunked != whole)
+        {
+            char message[64];
+            snprintf(message, sizeof(message), "output differs at maxLen %u", (unsigned)maxLen);
+            TEST_FAIL_MESSAGE(message);
+        }
+    }
+}
+
+HistoryStore history;
+
+void setUp() {}
+void tearDown() {}
+
+void test_history_chunks_match_whole()
+{
+    hostMillis() = 1000000;
+
+    // Wrap both rings, so the oldest entries are overwritten ones
+    for (uint32_t i = 0; i < HISTORY_GPS_DEPTH + 20; i++)
+        history.addGps("phone-1", 1000 + i * 2000, 27.7172 + i * 1e-5, 85.324 - i * 1e-5, 1300.5f, 4.5f, 1.25f);
+    for (uint32_t i = 0; i < (HISTORY_IMU_DEPTH + 10) * 5; i++)
+        history.addImu("phone-1", 1000 + i * 1000, 9.81f + (i % 7) * 0.1f, 0.02f * (i % 5));
+
+    for (uint32_t since : {0u, (uint32_t)(1000 + HISTORY_GPS_DEPTH * 2000)})
+    {
+        checkAllChunkSizes([since]()
+                           {
+                               auto cursor = std::make_shared<HistoryCursor>();
+                               cursor->deviceId = "phone-1";
+                               cursor->since = since;
+                               return [cursor](uint8_t *buffer, size_t maxLen)
+                               { return historyFillJson(history, *cursor, buffer, maxLen); };
+                           });
+    }
+}
+
+// A device with no history still yields a complete, empty document
+void test_history_unknown_device_is_empty_document()
+{
+    checkAllChunkSizes([]()
+                       {
+                           auto cursor = std::make_shared<HistoryCursor>();
+                           cursor->deviceId = "nobody";
+                           cursor->since = 0;
+                           return [cursor](uint8_t *buffer, size_t maxLen)
+                           { return historyFillJson(history, *cursor, buffer, maxLen); };
+                       });
+}
+
+void test_trace_chunks_match_whole()
+{
+    static const char *const names[] = {"loop", "sendBatch", "compressBatch", "handleSensorData"};
+
+    // Part of a ring, then a wrapped one
+    for (uint32_t events : {40u, (uint32_t)TRACE_BUFFER_SIZE * 2 + 7})
+    {
+        for (uint32_t i = 0; i < events; i++)
+            traceRecord(names[i % 4], 1000000 + i * 350, 20 + i % 300);
+
+        checkAllChunkSizes([]()
+                           {
+                               auto cursor = std::make_shared<TraceCursor>(traceBeginExport());
+                               return [cursor](uint8_t *buffer, size_t maxLen)
+                               { return traceFillChromeJson(*cursor, buffer, maxLen); };
+                           });
+    }
+}
+
+int main(int argc, char **argv)
+{
+    history.begin();
+    UNITY_BEGIN();
+    RUN_TEST(test_history_chunks_match_whole);
+    RUN_TEST(test_history_unknown_device_is_empty_document);
+    RUN_TEST(test_trace_chunks_match_whole);
+    return UNITY_END();
+}
@@ -0,0 +1,336 @@
+// DeflateLite on uplink batches built from realistic GPS/IMU frames: every
+// stream must inflate back to its input, and the ratio and CPU cost per
+// batch are reported for the batch sizes the bridge can be configured to
+//
+// The inflater below is a small, independent RFC 1950/1951 decoder for the
+// block types DeflateLite emits (fixed Huffman; stored for completeness).
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "config.h"
+#include "deflate_lite.h"
+#include "uplink_queue.h"
+
+// ====== Inflate ======
+
+struct BitReader
+{
+    const uint8_t *data;
+    size_t len;
+    size_t pos = 0; // In bits
+    bool overrun = false;
+
+    uint32_t bits(uint8_t count) // LSB first, as DEFLATE packs them
+    {
+        uint32_t v = 0;
+        for (uint8_t i = 0; i < count; i++, pos++)
+        {
+            if (pos / 8 >= len)
+            {
+                overrun = true;
+                return 0;
+            }
+            v |= ((data[pos / 8] >> (pos % 8)) & 1u) << i;
+        }
+        return v;
+    }
+
+    uint32_t huffman(uint8_t count) // Codes are MSB first
+    {
+        uint32_t v = 0;
+        for (uint8_t i = 0; i < count; i++)
+            v = (v << 1) | bits(1);
+        return v;
+    }
+};
+
+// Fixed literal/length code (RFC 1951 3.2.6): 7, 8 or 9 bits
+int fixedSymbol(BitReader &in)
+{
+    uint32_t code = in.huffman(7);
+    if (code <= 23)
+        return 256 + code;
+    code = (code << 1) | in.bits(1);
+    if (code >= 48 && code <= 191)
+        return code - 48;
+    if (code >= 192 && code <= 199)
+        return 280 + code - 192;
+    code = (code << 1) | in.bits(1);
+    if (code >= 400 && code <= 511)
+        return 144 + code - 400;
+    return -1;
+}
+
+uint32_t adler32(const std::vector<uint8_t> &data)
+{
+    uint32_t a = 1, b = 0;
+    for (uint8_t byte : data)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+// Decode a zlib stream; false on any malformed input
+bool inflateZlib(const uint8_t *data, size_t len, std::vector<uint8_t> &out)
+{
+    static const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                             35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                             3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16_t DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                           257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                           8193, 12289, 16385, 24577};
+    static const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                           7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    out.clear();
+    if (len < 6 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20))
+        return false;
+
+    BitReader in{data + 2, len - 6};
+    bool final;
+    do
+    {
+        final = in.bits(1);
+        uint32_t type = in.bits(2);
+        if (type == 0)
+        {
+            in.pos = (in.pos + 7) & ~(size_t)7;
+            uint32_t n = in.bits(16), nn = in.bits(16);
+            if ((n ^ 0xFFFF) != nn)
+                return false;
+            while (n-- && !in.overrun)
+                out.push_back(in.bits(8));
+        }
+        else if (type == 1)
+        {
+            for (;;)
+            {
+                int sym = fixedSymbol(in);
+                if (sym < 0 || in.overrun)
+                    return false;
+                if (sym < 256)
+                {
+                    out.push_back(sym);
+                    continue;
+                }
+                if (sym == 256)
+                    break;
+                if (sym > 285)
+                    return false;
+
+                uint32_t length = LENGTH_BASE[sym - 257] + in.bits(LENGTH_EXTRA[sym - 257]);
+                uint32_t code = in.huffman(5);
+                if (code > 29)
+                    return false;
+                uint32_t dist = DIST_BASE[code] + in.bits(DIST_EXTRA[code]);
+                if (dist > out.size())
+                    return false;
+                for (uint32_t i = 0; i < length; i++)
+                    out.push_back(out[out.size() - dist]);
+            }
+        }
+        else
+        {
+            return false; // Dynamic Huffman: DeflateLite never emits it
+        }
+        if (in.overrun)
+            return false;
+    } while (!final);
+
+    // Adler-32 follows the last block, big-endian
+    const uint8_t *tail = data + len - 4;
+    uint32_t checksum = (uint32_t)tail[0] << 24 | tail[1] << 16 | tail[2] << 8 | tail[3];
+    return (in.pos + 7) / 8 == len - 6 && checksum == adler32(out);
+}
+
+// ====== Realistic uplink traffic ======
+
+// Frames as handleSensorData() forwards them: the phone's fields plus the
+// bridge's timestamp, round trip and state version. A few phones interleaved.
+struct Traffic
+{
+    std::mt19937 rng{1234};
+    uint32_t now = 3600000;
+    uint32_t version = 100;
+    double lat[4] = {27.7172, 27.7011, 27.6844, 27.7290};
+    double lon[4] = {85.3240, 85.3162, 85.3301, 85.3412};
+
+    double uniform(double lo, double hi) { return lo + (hi - lo) * (rng() / 4294967296.0); }
+
+    String frame()
+    {
+        unsigned phone = rng() % 4;
+        now += rng() % 400;
+        char text[320];
+        if (rng() % 3 == 0)
+        {
+            lat[phone] += uniform(-2e-5, 2e-5);
+            lon[phone] += uniform(-2e-5, 2e-5);
+            snprintf(text, sizeof(text),
+                     "{\"type\":\"GPS\",\"username\":\"rider%u\",\"deviceId\":\"a1b2c3d4-%04u\",\"lat\":%.7f,"
+                     "\"lon\":%.7f,\"alt\":%.1f,\"accuracy\":%.1f,\"speed\":%.2f,\"timestamp\":%llu,"
+                     "\"bridgeTs\":%u,\"rtt\":%u,\"v\":%u}",
+                     phone, 1000 + phone * 37, lat[phone], lon[phone], uniform(1290, 1310), uniform(3, 15),
+                     uniform(0, 20), 1760000000000ull + now, now, (unsigned)(20 + rng() % 60), version++);
+        }
+        else
+        {
+            snprintf(text, sizeof(text),
+                     "{\"type\":\"IMU\",\"username\":\"rider%u\",\"deviceId\":\"a1b2c3d4-%04u\",\"accel\":{\"x\":%.3f,"
+                     "\"y\":%.3f,\"z\":%.3f},\"gyro\":{\"x\":%.4f,\"y\":%.4f,\"z\":%.4f},\"timestamp\":%llu,"
+                     "\"bridgeTs\":%u,\"rtt\":%u,\"v\":%u}",
+                     phone, 1000 + phone * 37, uniform(-1, 1), uniform(-1, 1), uniform(9.3, 10.3),
+                     uniform(-0.2, 0.2), uniform(-0.2, 0.2), uniform(-0.2, 0.2), 1760000000000ull + now, now,
+                     (unsigned)(20 + rng() % 60), version++);
+        }
+        return String(text);
+    }
+
+    // A batch as the uplink sends it
+    String batch(size_t records)
+    {
+        UplinkQueue queue;
+        for (size_t i = 0; i < records; i++)
+            queue.push(frame(), records);
+        return queue.batch(records);
+    }
+};
+
+const size_t BATCH_SIZES[] = {1, 4, 8, 16};
+
+DeflateLite deflate;
+
+bool roundTrips(const uint8_t *in, size_t len, size_t &compressed)
+{
+    std::vector<uint8_t> out(len + 64);
+    compressed = deflate.compress(in, len, out.data(), out.size());
+    std::vector<uint8_t> decoded;
+    return compressed > 0 && inflateZlib(out.data(), compressed, decoded) && decoded.size() == len &&
+           std::equal(decoded.begin(), decoded.end(), in);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_batches_round_trip()
+{
+    Traffic traffic;
+    for (size_t records : BATCH_SIZES)
+    {
+        for (int i = 0; i < 50; i++)
+        {
+            String batch = traffic.batch(records);
+            size_t compressed;
+            TEST_ASSERT_TRUE(roundTrips((const uint8_t *)batch.c_str(), batch.length(), compressed));
+            TEST_ASSERT_LESS_THAN(batch.length(), compressed);
+        }
+    }
+}
+
+// Long runs (258-byte matches), overlapping copies, matches at the window
+// edge, and inputs of a few bytes
+void test_edge_inputs_round_trip()
+{
+    std::vector<uint8_t> input;
+    size_t compressed;
+
+    for (size_t len : {1, 2, 3, 4, 5})
+    {
+        input.assign(len, 'a');
+        TEST_ASSERT_TRUE(roundTrips(input.data(), input.size(), compressed));
+    }
+
+    input.assign(5000, 'x');
+    TEST_ASSERT_TRUE(roundTrips(input.data(), input.size(), compressed));
+    TEST_ASSERT_LESS_THAN(100, compressed);
+
+    std::mt19937 rng(5);
+    input.clear();
+    std::vector<uint8_t> block(64);
+    for (uint8_t &b : block)
+        b = rng();
+    for (size_t gap : {(size_t)DeflateLite::WINDOW_SIZE - 64, (size_t)DeflateLite::WINDOW_SIZE, (size_t)3000})
+    {
+        input.insert(input.end(), block.begin(), block.end());
+        for (size_t i = 0; i < gap; i++)
+            input.push_back('a' + rng() % 26);
+    }
+    input.insert(input.end(), block.begin(), block.end());
+    TEST_ASSERT_TRUE(roundTrips(input.data(), input.size(), compressed));
+
+    // The checker itself: a flipped bit anywhere must not decode to the input
+    std::vector<uint8_t> stream(input.size() + 64), decoded;
+    compressed = deflate.compress(input.data(), input.size(), stream.data(), stream.size());
+    for (size_t i = 0; i < compressed; i += 97)
+    {
+        stream[i] ^= 0x10;
+        TEST_ASSERT_FALSE(inflateZlib(stream.data(), compressed, decoded) && decoded == input);
+        stream[i] ^= 0x10;
+    }
+}
+
+// Output that would not fit, and input over the limit, report 0 so the
+// batch goes out uncompressed
+void test_incompressible_and_oversize_return_zero()
+{
+    std::mt19937 rng(9);
+    std::vector<uint8_t> noise(2000), out(2000);
+    for (uint8_t &b : noise)
+        b = rng();
+    TEST_ASSERT_EQUAL(0, deflate.compress(noise.data(), noise.size(), out.data(), out.size()));
+
+    std::vector<uint8_t> big(DeflateLite::INPUT_LIMIT + 1, 'a');
+    out.resize(big.size());
+    TEST_ASSERT_EQUAL(0, deflate.compress(big.data(), big.size(), out.data(), out.size()));
+}
+
+void test_ratio_and_cost_per_batch()
+{
+    const int BATCHES = 200;
+    double ratio[4];
+    for (int n = 0; n < 4; n++)
+    {
+        Traffic traffic;
+        std::vector<String> batches;
+        size_t inBytes = 0, outBytes = 0;
+        for (int i = 0; i < BATCHES; i++)
+        {
+            batches.push_back(traffic.batch(BATCH_SIZES[n]));
+            inBytes += batches.back().length();
+        }
+
+        std::vector<uint8_t> out(8192);
+        auto start = std::chrono::steady_clock::now();
+        for (const String &batch : batches)
+            outBytes += deflate.compress((const uint8_t *)batch.c_str(), batch.length(), out.data(), out.size());
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        ratio[n] = (double)outBytes / inBytes;
+        char line[128];
+        snprintf(line, sizeof(line), "%2u records: %5u -> %4u bytes per batch (%.0f%%), %.1f us per batch on this host",
+                 (unsigned)BATCH_SIZES[n], (unsigned)(inBytes / BATCHES), (unsigned)(outBytes / BATCHES),
+                 ratio[n] * 100, us / BATCHES);
+        TEST_MESSAGE(line);
+    }
+
+    // Keys, usernames and deviceIds repeat across records, so bigger batches compress better
+    TEST_ASSERT_TRUE_MESSAGE(ratio[0] < 0.9, "single record barely compresses");
+    TEST_ASSERT_TRUE_MESSAGE(ratio[2] < 0.6, "default batch size compresses poorly");
+    TEST_ASSERT_TRUE_MESSAGE(ratio[3] <= ratio[1], "bigger batches compress worse");
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_batches_round_trip);
+    RUN_TEST(test_edge_inputs_round_trip);
+    RUN_TEST(test_incompressible_and_oversize_return_zero);
+    RUN_TEST(test_ratio_and_cost_per_batch);
+    return UNITY_END();
+}
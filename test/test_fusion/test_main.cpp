@@ -0,0 +1,222 @@
+// Accuracy of the GPS/IMU filter on synthetic tracks with known truth, and
+// what one update costs
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include <random>
+#include "config.h"
+#include "fusion.h"
+
+const double LAT0 = 27.7172, LON0 = 85.3240;
+const double METERS_PER_DEG_LON = 111320.0 * cos(LAT0 * DEG_TO_RAD);
+const double IMU_NOISE = 0.3; // m/s^2 on |a|, typical of a phone
+
+// Box-Muller on mt19937, so the noise is the same with every standard library
+struct Noise
+{
+    std::mt19937 rng;
+    explicit Noise(uint32_t seed) : rng(seed) {}
+
+    double gauss()
+    {
+        double u1 = (rng() + 1.0) / 4294967297.0;
+        double u2 = rng() / 4294967296.0;
+        return sqrt(-2 * log(u1)) * cos(2 * PI * u2);
+    }
+};
+
+struct TrackResult
+{
+    double rawRms;   // GPS fixes against truth, m
+    double fusedRms; // Filter output at 2 Hz against truth, where it would be sent, m
+    double speedRms; // Speed estimate against truth, where it would be sent, m/s
+    double sent;     // Share of the 2 Hz outputs beatsFix() lets through
+};
+
+// Ten minutes on a circle of `radius` at `speed`, GPS every 2 s with
+// `accuracy` (reported 1-sigma radius), IMU |a| every second with
+// `imuNoise`; scored after a 20 s warm-up
+TrackResult runTrack(double speed, double radius, float accuracy, double imuNoise, uint32_t seed)
+{
+    Noise noise(seed);
+    FusionFilter filter;
+    double rawSq = 0, fusedSq = 0, speedSq = 0;
+    int fixes = 0, ticks = 0, outputs = 0;
+
+    for (uint32_t ms = 0; ms <= 600000; ms += 250)
+    {
+        double w = speed / radius;
+        double x = radius * cos(w * ms / 1000.0), y = radius * sin(w * ms / 1000.0);
+
+        if (ms % 1000 == 0)
+        {
+            double centripetal = speed * speed / radius;
+            filter.observeImu(ms, sqrt(9.81 * 9.81 + centripetal * centripetal) + noise.gauss() * imuNoise);
+        }
+
+        if (ms % 2000 == 0)
+        {
+            double gx = x + noise.gauss() * accuracy / M_SQRT2, gy = y + noise.gauss() * accuracy / M_SQRT2;
+            filter.observeGps(ms, LAT0 + gy / 111320.0, LON0 + gx / METERS_PER_DEG_LON, accuracy);
+            if (ms > 20000)
+            {
+                rawSq += (gx - x) * (gx - x) + (gy - y) * (gy - y);
+                fixes++;
+            }
+        }
+
+        if (ms % 500 != 0 || ms <= 20000)
+            continue;
+        ticks++;
+        if (!filter.beatsFix())
+            continue;
+
+        double lat, lon;
+        float ve, vn;
+        filter.estimate(ms, lat, lon, ve, vn);
+        double fx = (lon - LON0) * METERS_PER_DEG_LON, fy = (lat - LAT0) * 111320.0;
+        fusedSq += (fx - x) * (fx - x) + (fy - y) * (fy - y);
+        double speedError = sqrt(ve * ve + vn * vn) - speed;
+        speedSq += speedError * speedError;
+        outputs++;
+    }
+
+    TrackResult result;
+    result.rawRms = sqrt(rawSq / fixes);
+    result.fusedRms = outputs ? sqrt(fusedSq / outputs) : 0;
+    result.speedRms = outputs ? sqrt(speedSq / outputs) : 0;
+    result.sent = (double)outputs / ticks;
+
+    char line[160];
+    snprintf(line, sizeof(line),
+             "%.1f m/s, r %.0f m, %.0f m fixes, IMU noise %.1f: raw %.2f m, fused %.2f m (%.0f%% sent), speed error "
+             "%.2f m/s",
+             speed, radius, accuracy, imuNoise, result.rawRms, result.fusedRms, result.sent * 100, result.speedRms);
+    TEST_MESSAGE(line);
+    return result;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// A phone accelerometer reads |a| with 0.1-0.5 m/s^2 of noise at rest; none
+// of it may be taken for motion
+void test_standing_still_smooths_gps_noise()
+{
+    for (double imuNoise : {0.1, 0.3, 0.5})
+    {
+        TrackResult r = runTrack(0, 150, 6, imuNoise, 7);
+        TEST_ASSERT_TRUE_MESSAGE(r.fusedRms < r.rawRms * 0.9, "fused error not below raw GPS");
+        TEST_ASSERT_TRUE_MESSAGE(r.sent > 0.6, "estimate held back while it beats the fixes");
+        TEST_ASSERT_TRUE_MESSAGE(r.speedRms < 1.0, "speed error");
+    }
+}
+
+void test_walking_smooths_gps_noise()
+{
+    TrackResult r = runTrack(1.4, 150, 6, IMU_NOISE, 8);
+    TEST_ASSERT_TRUE_MESSAGE(r.fusedRms < r.rawRms * 0.9, "fused error not below raw GPS");
+    TEST_ASSERT_TRUE_MESSAGE(r.sent > 0.6, "estimate held back while it beats the fixes");
+    TEST_ASSERT_TRUE_MESSAGE(r.speedRms < 1.0, "speed error");
+}
+
+void test_driving_smooths_gps_noise()
+{
+    TrackResult r = runTrack(12, 2000, 8, IMU_NOISE, 9);
+    TEST_ASSERT_TRUE_MESSAGE(r.fusedRms <= r.rawRms, "fused error above raw GPS");
+    TEST_ASSERT_TRUE_MESSAGE(r.sent > 0.5, "estimate held back while it beats the fixes");
+    TEST_ASSERT_TRUE_MESSAGE(r.speedRms < 1.5, "speed error");
+}
+
+// Round a 150 m turn at speed a constant-velocity model lags the truth by
+// more than the fixes are off; the estimate must stand down, not go out worse
+void test_tight_turn_never_sends_worse_than_gps()
+{
+    TrackResult r = runTrack(12, 150, 8, IMU_NOISE, 9);
+    TEST_ASSERT_TRUE_MESSAGE(r.fusedRms <= r.rawRms, "fused error above raw GPS");
+    TEST_ASSERT_TRUE_MESSAGE(r.sent < 0.5, "lagging estimate still sent");
+}
+
+void test_single_outlier_is_gated()
+{
+    FusionFilter filter;
+    for (uint32_t ms = 0; ms <= 60000; ms += 2000)
+        filter.observeGps(ms, LAT0, LON0, 5);
+
+    // One fix 500 m off, then back on track
+    filter.observeGps(62000, LAT0 + 500 / 111320.0, LON0, 5);
+    double lat, lon;
+    float ve, vn;
+    filter.estimate(62000, lat, lon, ve, vn);
+    TEST_ASSERT_TRUE_MESSAGE(fabs((lat - LAT0) * 111320.0) < 5, "outlier pulled the estimate");
+}
+
+void test_repeated_jump_is_accepted()
+{
+    FusionFilter filter;
+    for (uint32_t ms = 0; ms <= 60000; ms += 2000)
+        filter.observeGps(ms, LAT0, LON0, 5);
+
+    // Three fixes in a row agree on the new place: a real jump, not noise
+    for (uint32_t ms = 62000; ms <= 66000; ms += 2000)
+        filter.observeGps(ms, LAT0 + 500 / 111320.0, LON0, 5);
+    double lat, lon;
+    float ve, vn;
+    filter.estimate(66000, lat, lon, ve, vn);
+    TEST_ASSERT_TRUE_MESSAGE((lat - LAT0) * 111320.0 > 250, "jump not followed");
+}
+
+void test_stale_state_restarts_at_next_fix()
+{
+    FusionFilter filter;
+    filter.observeGps(0, LAT0, LON0, 5);
+    filter.observeGps(2000, LAT0, LON0, 5);
+
+    // Over a minute without fixes, then somewhere else
+    filter.observeGps(70000, LAT0 + 0.01, LON0, 5);
+    TEST_ASSERT_EQUAL_UINT32(70000, filter.lastFix);
+    TEST_ASSERT_TRUE_MESSAGE(filter.lat0 == LAT0 + 0.01, "origin not moved to the new fix");
+}
+
+void test_update_cost()
+{
+    Noise noise(11);
+    FusionFilter filter;
+    const uint32_t UPDATES = 200000;
+    double sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < UPDATES; i++)
+    {
+        uint32_t ms = i * 500;
+        if (i % 4 == 0)
+            filter.observeGps(ms, LAT0 + noise.gauss() * 5e-5, LON0 + noise.gauss() * 5e-5, 6);
+        else
+            filter.observeImu(ms, 9.81f + i % 7 * 0.1f);
+        sink += filter.px;
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    char line[96];
+    snprintf(line, sizeof(line), "%.0f ns per update on this host (%u updates)", ns / UPDATES, (unsigned)UPDATES);
+    TEST_MESSAGE(line);
+
+    // A few dozen FLOPs; even an unoptimized host build stays far below this
+    TEST_ASSERT_TRUE_MESSAGE(ns / UPDATES < 5000, "filter update unexpectedly slow");
+    TEST_ASSERT_TRUE(sink == sink); // Keep the loop from being optimized away
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_standing_still_smooths_gps_noise);
+    RUN_TEST(test_walking_smooths_gps_noise);
+    RUN_TEST(test_driving_smooths_gps_noise);
+    RUN_TEST(test_tight_turn_never_sends_worse_than_gps);
+    RUN_TEST(test_single_outlier_is_gated);
+    RUN_TEST(test_repeated_jump_is_accepted);
+    RUN_TEST(test_stale_state_restarts_at_next_fix);
+    RUN_TEST(test_update_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,173 @@
+// The grid index must answer exactly what testing every fence would, at a
+// cost per fix that stays flat as fences are added at constant density
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "config.h"
+#include "geofence.h"
+
+const double LAT0 = 27.70, LON0 = 85.30;
+const int QUERIES = 100000;
+
+// `count` fences over a square that grows with the count, so each fix has
+// about as many fences nearby whatever the total; half circles of 50-300 m,
+// half irregular polygons of 4-8 vertices. `large` city-sized circles go on
+// top to exercise the list every fix checks.
+struct FenceSet
+{
+    GeofenceIndex index;
+    double span;
+    std::mt19937 rng;
+
+    FenceSet(size_t count, size_t large, uint32_t seed) : rng(seed)
+    {
+        span = 0.05 * sqrt(count / 100.0);
+        for (size_t i = 0; i < count; i++)
+        {
+            double lat = LAT0 + uniform() * span, lon = LON0 + uniform() * span;
+            String id("f");
+            id += String((unsigned)i);
+            if (i % 2)
+            {
+                TEST_ASSERT_TRUE(index.addCircle(id, lat, lon, 50 + uniform() * 250));
+            }
+            else
+            {
+                int n = 4 + rng() % 5;
+                double r = 0.0005 + uniform() * 0.002;
+                std::vector<double> points;
+                for (int k = 0; k < n; k++)
+                {
+                    double a = 2 * PI * k / n;
+                    points.push_back(lat + r * sin(a) * (0.7 + 0.3 * uniform()));
+                    points.push_back(lon + r * cos(a) * (0.7 + 0.3 * uniform()));
+                }
+                TEST_ASSERT_TRUE(index.addPolygon(id, points.data(), n));
+            }
+        }
+        for (size_t i = 0; i < large; i++)
+            TEST_ASSERT_TRUE(index.addCircle(String("city"), LAT0 + span / 2, LON0 + span / 2, 3000 + 1000 * i));
+    }
+
+    double uniform() { return rng() / 4294967296.0; }
+
+    std::vector<double> fixes(int count)
+    {
+        std::vector<double> latLon;
+        for (int i = 0; i < count; i++)
+        {
+            latLon.push_back(LAT0 + uniform() * span);
+            latLon.push_back(LON0 + uniform() * span);
+        }
+        return latLon;
+    }
+
+    // Fences containing the fix, by testing every one
+    std::vector<uint16_t> bruteForce(double lat, double lon) const
+    {
+        std::vector<uint16_t> inside;
+        for (size_t i = 0; i < index.size(); i++)
+        {
+            if (index.fence(i).contains(lat, lon))
+                inside.push_back(i);
+        }
+        return inside;
+    }
+};
+
+// Best of three passes, ns per fix
+template <typename F>
+double timePerFix(const std::vector<double> &fixes, F query)
+{
+    double best = 1e30;
+    for (int pass = 0; pass < 3; pass++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < fixes.size(); i += 2)
+            query(fixes[i], fixes[i + 1]);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        best = min(best, ns / (fixes.size() / 2));
+    }
+    return best;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_index_matches_brute_force()
+{
+    for (size_t count : {10, 100, 500})
+    {
+        FenceSet set(count, 2, count);
+        std::vector<double> fixes = set.fixes(QUERIES / 10);
+        std::vector<uint16_t> inside;
+        size_t hits = 0;
+        for (size_t i = 0; i < fixes.size(); i += 2)
+        {
+            set.index.query(fixes[i], fixes[i + 1], inside);
+            TEST_ASSERT_TRUE(inside == set.bruteForce(fixes[i], fixes[i + 1]));
+            hits += inside.size();
+        }
+        TEST_ASSERT_GREATER_THAN(0, hits); // The fixes do land in fences
+    }
+}
+
+void test_fence_limit()
+{
+    GeofenceIndex index;
+    for (size_t i = 0; i < GEOFENCE_MAX_FENCES; i++)
+        TEST_ASSERT_TRUE(index.addCircle(String("f"), LAT0, LON0 + i * 0.01, 100));
+    TEST_ASSERT_FALSE(index.addCircle(String("over"), LAT0, LON0, 100));
+    TEST_ASSERT_FALSE(index.addCircle(String("empty"), LAT0, LON0, 0));
+
+    double twoPoints[] = {LAT0, LON0, LAT0 + 0.01, LON0};
+    index.clear();
+    TEST_ASSERT_FALSE(index.addPolygon(String("line"), twoPoints, 2));
+}
+
+void test_cost_per_fix_stays_flat()
+{
+    double indexed[3], brute[3];
+    size_t counts[] = {10, 100, 500};
+    for (int n = 0; n < 3; n++)
+    {
+        FenceSet set(counts[n], 0, 100 + n);
+        std::vector<double> fixes = set.fixes(QUERIES);
+        std::vector<uint16_t> inside;
+        size_t sink = 0;
+
+        indexed[n] = timePerFix(fixes, [&](double lat, double lon)
+                                {
+                                    set.index.query(lat, lon, inside);
+                                    sink += inside.size();
+                                });
+        brute[n] = timePerFix(fixes, [&](double lat, double lon)
+                              {
+                                  for (size_t i = 0; i < set.index.size(); i++)
+                                      sink += set.index.fence(i).contains(lat, lon);
+                              });
+
+        char line[112];
+        snprintf(line, sizeof(line), "%3u fences: indexed %.0f ns/fix, every fence %.0f ns/fix (%u hits)",
+                 (unsigned)counts[n], indexed[n], brute[n], (unsigned)sink);
+        TEST_MESSAGE(line);
+    }
+
+    // 50x the fences: checking them all scales with the count, the index must not.
+    // Loose bounds so a busy host does not fail the run.
+    TEST_ASSERT_TRUE_MESSAGE(brute[2] > brute[0] * 10, "brute force did not scale; timing unreliable");
+    TEST_ASSERT_TRUE_MESSAGE(indexed[2] < indexed[0] * 3 + 100, "indexed cost grows with the fence count");
+    TEST_ASSERT_TRUE_MESSAGE(indexed[2] * 5 < brute[2], "index no faster than testing every fence");
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_index_matches_brute_force);
+    RUN_TEST(test_fence_limit);
+    RUN_TEST(test_cost_per_fix_stays_flat);
+    return UNITY_END();
+}
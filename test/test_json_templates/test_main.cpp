@@ -0,0 +1,154 @@
+// The prebuilt control messages: JsonWriter::str escapes what JSON requires,
+// builders report the full length snprintf-style whatever the buffer, and
+// JsonBuffer's retry yields exactly the message an ample buffer would
+
+#include <Arduino.h>
+#include <unity.h>
+#include <string>
+#include "json_templates.h"
+
+const size_t GUARD = 16;
+const char CANARY = (char)0xA5;
+
+std::string quoted(const char *s)
+{
+    char out[256];
+    size_t len = JsonWriter(out, sizeof(out)).str(s).length();
+    TEST_ASSERT_LESS_THAN(sizeof(out), len);
+    TEST_ASSERT_EQUAL(len, strlen(out));
+    return out;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_str_escapes_quotes_and_backslashes()
+{
+    TEST_ASSERT_EQUAL_STRING("\"\"", quoted("").c_str());
+    TEST_ASSERT_EQUAL_STRING("\"plain\"", quoted("plain").c_str());
+    TEST_ASSERT_EQUAL_STRING("\"say \\\"hi\\\"\"", quoted("say \"hi\"").c_str());
+    TEST_ASSERT_EQUAL_STRING("\"C:\\\\temp\\\\\"", quoted("C:\\temp\\").c_str());
+    TEST_ASSERT_EQUAL_STRING("\"\\\\\\\"\"", quoted("\\\"").c_str());
+}
+
+void test_str_escapes_control_characters()
+{
+    TEST_ASSERT_EQUAL_STRING("\"a\\nb\\rc\\td\\be\\ff\"", quoted("a\nb\rc\td\be\ff").c_str());
+    TEST_ASSERT_EQUAL_STRING("\"\\u0001\\u001f\\u000b\"", quoted("\x01\x1f\x0b").c_str());
+
+    // Every other byte below 0x20 takes the \u form, nothing from 0x20 up does
+    for (int c = 1; c < 0x80; c++)
+    {
+        char in[2] = {(char)c, '\0'};
+        std::string out = quoted(in);
+        bool named = strchr("\"\\\n\r\t\b\f", c) != nullptr;
+        if (named)
+            TEST_ASSERT_EQUAL(4, out.size());
+        else if (c < 0x20)
+            TEST_ASSERT_EQUAL(8, out.size());
+        else
+            TEST_ASSERT_EQUAL(3, out.size());
+    }
+}
+
+void test_str_passes_utf8_through()
+{
+    TEST_ASSERT_EQUAL_STRING("\"Kathmandu \xe0\xa4\x95\xe0\xa4\xbe \xf0\x9f\x93\x8d\"",
+                             quoted("Kathmandu \xe0\xa4\x95\xe0\xa4\xbe \xf0\x9f\x93\x8d").c_str());
+}
+
+void test_num_prints_full_range()
+{
+    char out[16];
+    TEST_ASSERT_EQUAL_STRING("0", (JsonWriter(out, sizeof(out)).num(0), out));
+    TEST_ASSERT_EQUAL_STRING("42", (JsonWriter(out, sizeof(out)).num(42), out));
+    TEST_ASSERT_EQUAL_STRING("4294967295", (JsonWriter(out, sizeof(out)).num(4294967295u), out));
+}
+
+// For every capacity the builder returns the same length, writes nothing past
+// `cap`, and leaves a terminated prefix of the full message
+void test_truncation_reports_full_length()
+{
+    String username = "Ram \"the driver\" \\ \x01";
+    char whole[256];
+    size_t full = jsonUserConnected(whole, sizeof(whole), username, "phone-1", 7, 12);
+    TEST_ASSERT_LESS_THAN(sizeof(whole), full);
+    TEST_ASSERT_EQUAL(full, strlen(whole));
+
+    for (size_t cap = 0; cap <= full + 1; cap++)
+    {
+        char out[256 + GUARD];
+        memset(out, CANARY, sizeof(out));
+        TEST_ASSERT_EQUAL(full, jsonUserConnected(out, cap, username, "phone-1", 7, 12));
+        for (size_t i = cap; i < cap + GUARD; i++)
+            TEST_ASSERT_EQUAL(CANARY, out[i]);
+        if (cap == 0)
+            continue;
+
+        size_t kept = cap - 1 < full ? cap - 1 : full;
+        TEST_ASSERT_EQUAL(kept, strlen(out));
+        TEST_ASSERT_EQUAL(0, memcmp(out, whole, kept));
+    }
+}
+
+// The caller pattern in main.cpp: try the stack buffer, grow on overflow and
+// build again into exactly len + 1
+template <size_t N>
+std::string buildUserConnected(JsonBuffer<N> &buffer, const String &username, bool &grew)
+{
+    char *msg = buffer.local;
+    size_t len = jsonUserConnected(msg, buffer.SIZE, username, "phone-1", 7, 12);
+    grew = len >= buffer.SIZE;
+    if (grew)
+    {
+        msg = buffer.grow(len);
+        TEST_ASSERT_EQUAL(len, jsonUserConnected(msg, len + 1, username, "phone-1", 7, 12));
+    }
+    TEST_ASSERT_EQUAL(len, strlen(msg));
+    return std::string(msg, len);
+}
+
+void test_json_buffer_retry_matches_ample_buffer()
+{
+    for (size_t nameLen : {(size_t)0, (size_t)10, (size_t)80, (size_t)200, (size_t)1000})
+    {
+        std::string name;
+        for (size_t i = 0; i < nameLen; i++)
+            name += "ab\"\n"[i % 4];
+        String username(name.c_str());
+
+        std::unique_ptr<char[]> ample(new char[8 * nameLen + 256]);
+        size_t full = jsonUserConnected(ample.get(), 8 * nameLen + 256, username, "phone-1", 7, 12);
+
+        JsonBuffer<160> buffer;
+        bool grew;
+        std::string built = buildUserConnected(buffer, username, grew);
+        TEST_ASSERT_EQUAL(full >= 160, grew);
+        TEST_ASSERT_EQUAL_STRING(ample.get(), built.c_str());
+    }
+}
+
+void test_constant_replies_are_single_objects()
+{
+    for (const char *reply : {JSON_RESUME_FAILED, JSON_RESUMED_SHARING, JSON_RESUMED_PAUSED, JSON_CONFIG_UNAUTHORIZED,
+                              JSON_MESSAGE_TOO_LARGE, JSON_GEOFENCE_UNAUTHORIZED})
+    {
+        size_t len = strlen(reply);
+        TEST_ASSERT_EQUAL('{', reply[0]);
+        TEST_ASSERT_EQUAL('}', reply[len - 1]);
+        TEST_ASSERT_EQUAL(0, strncmp(reply, "{\"type\":\"", 9));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_str_escapes_quotes_and_backslashes);
+    RUN_TEST(test_str_escapes_control_characters);
+    RUN_TEST(test_str_passes_utf8_through);
+    RUN_TEST(test_num_prints_full_range);
+    RUN_TEST(test_truncation_reports_full_length);
+    RUN_TEST(test_json_buffer_retry_matches_ample_buffer);
+    RUN_TEST(test_constant_replies_are_single_objects);
+    return UNITY_END();
+}
@@ -0,0 +1,1055 @@
+// Multi-day soak of the ingest and uplink path on the host. Phones come and
+// go (quick resumes, re-registers that supersede a pending session), their
+// JSON frames are parsed and re-serialized with ArduinoJson and go through
+// the sessions' clock and filter, the fence index, StateCache, HistoryStore,
+// the dashboard outboxes and the Flask queue, and batches are compressed and
+// sent to stub servers with outages, all as loop() and the WebSocket
+// handlers do it. The heap is a counting arena; after a warm-up
+// day, live bytes, live blocks, the daily peak and fragmentation must stay
+// flat day over day, or the run fails.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+#include "config.h"
+#include "clock_sync.h"
+#include "deflate_lite.h"
+#include "fusion.h"
+#include "geofence.h"
+#include "history_ring.h"
+#include "json_templates.h"
+#include "msg_router.h"
+#include "state_cache.h"
+#include "uplink_pool.h"
+#include "uplink_queue.h"
+#include "ws_outbox.h"
+
+#ifndef SOAK_DAYS
+#define SOAK_DAYS 3 // Warm-up, baseline, then days checked against it; -D SOAK_DAYS=30 for a long run
+#endif
+
+// ====== Counting allocator ======
+// Every operator new (String, std containers, JsonDocument, JsonBuffer) is served from one
+// fixed arena through an address-ordered first-fit free list, roughly how a
+// small embedded heap behaves, so fragmentation can be measured: the share
+// of free memory outside the largest free block. The arena is sized like
+// the ESP32's free internal heap; running out of it fails the test.
+// HistoryStore's pool is malloc'ed once at begin() and not counted.
+namespace arena
+{
+const size_t SIZE = 192 * 1024;
+const size_t HEADER = 16; // Block size, keeps payloads 16-byte aligned
+
+struct FreeBlock
+{
+    size_t size;
+    FreeBlock *next;
+};
+
+alignas(16) uint8_t memory[SIZE];
+FreeBlock *freeList = nullptr;
+bool ready = false;
+
+size_t allocations = 0; // Ever made
+size_t liveBlocks = 0;
+size_t liveBytes = 0; // Including headers and rounding
+size_t peakBytes = 0;
+
+void *allocate(size_t n)
+{
+    if (!ready)
+    {
+        freeList = (FreeBlock *)memory;
+        freeList->size = SIZE;
+        freeList->next = nullptr;
+        ready = true;
+    }
+
+    size_t need = (n + HEADER + 15) & ~(size_t)15;
+    for (FreeBlock **link = &freeList; *link; link = &(*link)->next)
+    {
+        FreeBlock *block = *link;
+        if (block->size < need)
+            continue;
+
+        if (block->size - need >= 32)
+        {
+            FreeBlock *rest = (FreeBlock *)((uint8_t *)block + need);
+            rest->size = block->size - need;
+            rest->next = block->next;
+            *link = rest;
+        }
+        else
+        {
+            need = block->size; // Too small a remainder to track
+            *link = block->next;
+        }
+
+        *(size_t *)block = need;
+        allocations++;
+        liveBlocks++;
+        liveBytes += need;
+        peakBytes = max(peakBytes, liveBytes);
+        return (uint8_t *)block + HEADER;
+    }
+
+    fprintf(stderr, "arena exhausted: %u bytes requested, %u live\n", (unsigned)n, (unsigned)liveBytes);
+    abort();
+}
+
+void release(void *p)
+{
+    if (!p)
+        return;
+
+    FreeBlock *block = (FreeBlock *)((uint8_t *)p - HEADER);
+    block->size = *(size_t *)block;
+    liveBlocks--;
+    liveBytes -= block->size;
+
+    FreeBlock *prev = nullptr;
+    FreeBlock *next = freeList;
+    while (next && next < block)
+    {
+        prev = next;
+        next = next->next;
+    }
+
+    block->next = next;
+    if (next && (uint8_t *)block + block->size == (uint8_t *)next)
+    {
+        block->size += next->size;
+        block->next = next->next;
+    }
+    if (prev && (uint8_t *)prev + prev->size == (uint8_t *)block)
+    {
+        prev->size += block->size;
+        prev->next = block->next;
+    }
+    else if (prev)
+    {
+        prev->next = block;
+    }
+    else
+    {
+        freeList = block;
+    }
+}
+
+size_t largestFree()
+{
+    size_t largest = 0;
+    for (FreeBlock *b = freeList; b; b = b->next)
+        largest = max(largest, b->size);
+    return largest;
+}
+
+uint8_t fragmentation()
+{
+    size_t free = SIZE - liveBytes;
+    return free ? 100 - (uint8_t)(largestFree() * 100 / free) : 0;
+}
+} // namespace arena
+
+void *operator new(size_t n) { return arena::allocate(n); }
+void *operator new[](size_t n) { return arena::allocate(n); }
+void operator delete(void *p) noexcept { arena::release(p); }
+void operator delete[](void *p) noexcept { arena::release(p); }
+void operator delete(void *p, size_t) noexcept { arena::release(p); }
+void operator delete[](void *p, size_t) noexcept { arena::release(p); }
+
+// ====== Simulated bridge ======
+// The session and message paths below follow main.cpp function for function
+// (dispatchMessage, handleRegister, handleResume, handleSensorData,
+// checkGeofences, sendFused, buildSnapshotJson and the loop() session sweep),
+// on the same ArduinoJson documents; only the sockets are replaced by calls.
+
+const uint32_t LOOP_MS = 100;        // One loop() pass
+const uint32_t DAY_MS = 86400000;
+const size_t DEVICE_POOL = 40;       // More than StateCache and HistoryStore hold
+const size_t MAX_PHONES = 8;         // Connected at once
+const uint32_t SLOW_CLIENT = 1;      // Dashboard whose socket is always backed up
+const uint32_t GPS_MS = 2000, IMU_MS = 1000;
+const double LAT0 = 27.70, LON0 = 85.30;
+
+// Field for field main.cpp's UserSession, so the copies made on resume and
+// supersede move the same strings, filter state and fence list
+struct UserSession
+{
+    String username;
+    String deviceId;
+    uint32_t clientId;
+    unsigned long lastSeen;
+    bool dataSharingEnabled;
+    bool disconnectPending;
+    unsigned long disconnectTime;
+    bool offlineAnnounced = false;
+    String resumeToken;
+    bool superseded = false;
+    ClockSync clock;
+    FusionFilter fusion;
+    unsigned long lastFused = 0;
+    std::vector<uint16_t> fencesInside;
+};
+
+// One handset: what it would keep in the app, plus when it moves and drops
+struct Phone
+{
+    String username;
+    String deviceId;
+    String resumeToken; // From REGISTERED; tried with RESUME on reconnect
+    uint32_t clientId = 0;
+    bool connected = false;
+    bool needRegister = false; // RESUME_FAILED came back
+    bool needSharing = false;  // REGISTERED came back
+    bool pongDue = false;
+    uint32_t pingT0 = 0;
+    uint32_t leaveAt = 0, returnAt = 0; // returnAt: reconnect then, 0 if not coming back soon
+    uint32_t nextGps = 0, nextImu = 0;
+    int64_t skew = 0; // Date.now() minus bridge millis()
+    double homeLat = 0, homeLon = 0; // Where the phone wanders around
+    double lat = 0, lon = 0;
+};
+
+struct DayStats
+{
+    size_t allocations;
+    size_t liveBytes;
+    size_t liveBlocks;
+    size_t peakBytes;
+    uint8_t fragmentation;
+    size_t largestFree;
+};
+
+struct Bridge
+{
+    std::mt19937 rng{42};
+    StateCache stateCache;
+    HistoryStore history;
+    GeofenceIndex geofences;
+    UplinkQueue uplinkQueue;
+    UplinkPool uplinkPool;
+    std::map<uint32_t, UserSession> activeSessions;
+    std::map<unsigned, Phone> phones; // By device number
+    std::map<uint32_t, ClientOutbox> outboxes;
+    uint32_t nextClientId = 100;
+    bool servers[2] = {true, true};
+    uint32_t delivered = 0, dropped = 0, frames = 0;
+    uint32_t resumes = 0, supersedes = 0, fused = 0, crossings = 0;
+    uint32_t leakEvery = 0; // Deliberately leak a block every this many frames, to check the harness
+    char *volatile leaked = nullptr;
+
+    uint32_t chance(uint32_t n) { return rng() % n; }
+
+    void begin()
+    {
+        static const char *const hosts[] = {"10.0.0.1:5000", "10.0.0.2:5000"};
+        history.begin();
+        uplinkPool.begin(hosts, 2);
+        for (uint32_t id = 0; id < 3; id++)
+            outboxes[id] = ClientOutbox();
+
+        // A yard around every fourth device's home, as GEOFENCE_SET would load them
+        JsonDocument fenceDoc;
+        JsonArray fences = fenceDoc.to<JsonArray>();
+        for (unsigned device = 0; device < DEVICE_POOL; device += 4)
+        {
+            char id[16];
+            snprintf(id, sizeof(id), "yard-%u", device);
+            JsonObject fence = fences.add<JsonObject>();
+            fence["id"] = id;
+            fence["type"] = "circle";
+            fence["lat"] = LAT0 + device * 0.001;
+            fence["lon"] = LON0;
+            fence["radius"] = 15;
+        }
+        geofences.loadJson(fenceDoc.as<JsonArrayConst>());
+    }
+
+    // ---- Bridge side, as in main.cpp ----
+
+    void broadcast(const char *msg, size_t len, const String &key)
+    {
+        ParkedText parked;
+        for (auto &entry : outboxes)
+        {
+            ClientOutbox &box = entry.second;
+            if (entry.first != SLOW_CLIENT && box.pending.empty())
+            {
+                box.sent++;
+                continue;
+            }
+            if (!parked)
+            {
+                String copy;
+                copy.concat(msg, len);
+                parked = std::make_shared<const String>(copy);
+            }
+            box.defer(key, parked);
+            box.trimTo(CLIENT_BACKLOG_BUDGET);
+        }
+    }
+
+    void broadcast(const String &msg, const String &key) { broadcast(msg.c_str(), msg.length(), key); }
+
+    void queueForFlask(const JsonDocument &doc)
+    {
+        String jsonString;
+        serializeJson(doc, jsonString);
+        uplinkQueue.push(jsonString, FLASK_QUEUE_SIZE);
+    }
+
+    void queueForFlask(const char *json) { uplinkQueue.push(String(json), FLASK_QUEUE_SIZE); }
+
+    void sendClockPing(UserSession &session)
+    {
+        session.clock.lastPing = millis();
+        char pingMsg[48];
+        toPhone(session.clientId, pingMsg, jsonTimePing(pingMsg, sizeof(pingMsg), session.clock.lastPing));
+    }
+
+    void announceConnected(UserSession &session)
+    {
+        uint32_t version = stateCache.setOnline(session.deviceId, session.username, true);
+        JsonBuffer<160> buffer;
+        char *notifyMsg = buffer.local;
+        size_t len = jsonUserConnected(notifyMsg, buffer.SIZE, session.username, session.deviceId, session.clientId, version);
+        if (len >= buffer.SIZE)
+        {
+            notifyMsg = buffer.grow(len);
+            jsonUserConnected(notifyMsg, len + 1, session.username, session.deviceId, session.clientId, version);
+        }
+        broadcast(notifyMsg, len, "0:" + session.deviceId);
+        queueForFlask(notifyMsg);
+    }
+
+    void announceDisconnected(UserSession &session)
+    {
+        session.offlineAnnounced = true;
+        uint32_t version = stateCache.setOnline(session.deviceId, session.username, false);
+        JsonBuffer<128> buffer;
+        char *alertMsg = buffer.local;
+        size_t len = jsonUserDisconnect(alertMsg, buffer.SIZE, session.username, session.deviceId, version);
+        if (len >= buffer.SIZE)
+        {
+            alertMsg = buffer.grow(len);
+            jsonUserDisconnect(alertMsg, len + 1, session.username, session.deviceId, version);
+        }
+        broadcast(alertMsg, len, "0:" + session.deviceId);
+        queueForFlask(alertMsg);
+    }
+
+    void supersede(UserSession &session)
+    {
+        session.superseded = true;
+        session.disconnectPending = true;
+        session.resumeToken = "";
+        supersedes++;
+    }
+
+    void handleRegister(uint32_t clientId, JsonDocument &doc)
+    {
+        UserSession session;
+        session.username = doc["username"].as<String>();
+        session.deviceId = doc["deviceId"].as<String>();
+        session.clientId = clientId;
+        session.lastSeen = millis();
+        session.dataSharingEnabled = false;
+        session.disconnectPending = false;
+        char token[17];
+        snprintf(token, sizeof(token), "%08x%08x", (unsigned)rng(), (unsigned)rng());
+        session.resumeToken = token;
+
+        for (auto &entry : activeSessions)
+        {
+            if (entry.first != clientId && entry.second.deviceId == session.deviceId)
+            {
+                session.fencesInside = entry.second.fencesInside;
+                supersede(entry.second);
+            }
+        }
+
+        UserSession &registered = activeSessions[clientId] = session;
+        sendClockPing(registered);
+
+        char confirmMsg[64];
+        toPhone(clientId, confirmMsg, jsonRegistered(confirmMsg, sizeof(confirmMsg), registered.resumeToken));
+        announceConnected(registered);
+    }
+
+    void handleResume(uint32_t clientId, JsonDocument &doc)
+    {
+        const char *deviceId = doc["deviceId"] | "";
+        const char *token = doc["token"] | "";
+
+        auto it = activeSessions.begin();
+        while (it != activeSessions.end() &&
+               !(it->second.deviceId == deviceId && it->second.resumeToken.length() && it->second.resumeToken == token))
+            ++it;
+
+        if (it == activeSessions.end())
+        {
+            toPhone(clientId, JSON_RESUME_FAILED, sizeof(JSON_RESUME_FAILED) - 1);
+            return;
+        }
+
+        uint32_t oldClientId = it->first;
+        UserSession resumed = it->second;
+        if (oldClientId != clientId)
+            supersede(it->second);
+
+        bool wasAnnounced = resumed.offlineAnnounced;
+        resumed.clientId = clientId;
+        resumed.lastSeen = millis();
+        resumed.disconnectPending = false;
+        resumed.offlineAnnounced = false;
+        UserSession &session = activeSessions[clientId] = resumed;
+        resumes++;
+
+        if (session.dataSharingEnabled)
+            toPhone(clientId, JSON_RESUMED_SHARING, sizeof(JSON_RESUMED_SHARING) - 1);
+        else
+            toPhone(clientId, JSON_RESUMED_PAUSED, sizeof(JSON_RESUMED_PAUSED) - 1);
+        sendClockPing(session);
+
+        if (wasAnnounced)
+            announceConnected(session);
+    }
+
+    void sendGeofenceEvent(UserSession &session, const Geofence &fence, bool enter, double lat, double lon,
+                           uint32_t bridgeTs)
+    {
+        JsonDocument eventDoc;
+        eventDoc["type"] = enter ? "GEOFENCE_ENTER" : "GEOFENCE_EXIT";
+        eventDoc["username"] = session.username;
+        eventDoc["deviceId"] = session.deviceId;
+        eventDoc["fenceId"] = fence.id;
+        eventDoc["lat"] = lat;
+        eventDoc["lon"] = lon;
+        eventDoc["bridgeTs"] = bridgeTs;
+
+        String eventMsg;
+        serializeJson(eventDoc, eventMsg);
+        broadcast(eventMsg, "0:GEOFENCE:" + session.deviceId + ":" + fence.id);
+        queueForFlask(eventDoc);
+        crossings++;
+    }
+
+    void checkGeofences(UserSession &session, double lat, double lon, uint32_t bridgeTs)
+    {
+        static std::vector<uint16_t> inside;
+        geofences.query(lat, lon, inside);
+
+        std::vector<uint16_t> &previous = session.fencesInside;
+        if (inside == previous)
+            return;
+
+        size_t i = 0, j = 0;
+        while (i < previous.size() || j < inside.size())
+        {
+            if (j == inside.size() || (i < previous.size() && previous[i] < inside[j]))
+                sendGeofenceEvent(session, geofences.fence(previous[i++]), false, lat, lon, bridgeTs);
+            else if (i == previous.size() || inside[j] < previous[i])
+                sendGeofenceEvent(session, geofences.fence(inside[j++]), true, lat, lon, bridgeTs);
+            else
+                i++, j++;
+        }
+        previous = inside;
+    }
+
+    void handleSensorData(JsonDocument &doc, UserSession *session, MsgType msgType)
+    {
+        session->lastSeen = millis();
+        if (!session->dataSharingEnabled)
+            return;
+
+        if (session->clock.synced() && doc["timestamp"].is<int64_t>())
+        {
+            doc["bridgeTs"] = session->clock.toBridgeTime(doc["timestamp"].as<int64_t>());
+            doc["rtt"] = session->clock.rtt;
+        }
+        else
+        {
+            doc["bridgeTs"] = session->lastSeen;
+        }
+
+        uint32_t bridgeTs = doc["bridgeTs"].as<uint32_t>();
+        if (msgType == MsgType::Gps)
+        {
+            double lat = doc["lat"], lon = doc["lon"];
+            float accuracy = doc["accuracy"];
+            history.addGps(session->deviceId.c_str(), bridgeTs, lat, lon, doc["alt"].as<float>(), accuracy,
+                           doc["speed"].as<float>());
+            session->fusion.observeGps(bridgeTs, lat, lon, accuracy);
+            checkGeofences(*session, lat, lon, bridgeTs);
+        }
+        else
+        {
+            float ax = doc["accel"]["x"], ay = doc["accel"]["y"], az = doc["accel"]["z"];
+            float gx = doc["gyro"]["x"], gy = doc["gyro"]["y"], gz = doc["gyro"]["z"];
+            float accelMag = sqrtf(ax * ax + ay * ay + az * az);
+            history.addImu(session->deviceId.c_str(), bridgeTs, accelMag, sqrtf(gx * gx + gy * gy + gz * gz));
+            session->fusion.observeImu(bridgeTs, accelMag);
+        }
+
+        doc["v"] = stateCache.setOnline(session->deviceId, session->username, true);
+
+        String output;
+        serializeJson(doc, output);
+        stateCache.storeFrame(session->deviceId, msgType == MsgType::Gps, output);
+        broadcast(output, String("1:") + msgTypeName(msgType) + ":" + session->deviceId);
+        queueForFlask(doc);
+        frames++;
+
+        if (leakEvery && frames % leakEvery == 0)
+            leaked = new char[1]; // Kept in a volatile so the allocation cannot be elided
+    }
+
+    void sendFused(UserSession &session, unsigned long now)
+    {
+        double lat, lon;
+        float ve, vn;
+        session.fusion.estimate(now, lat, lon, ve, vn);
+
+        float heading = atan2f(ve, vn) * RAD_TO_DEG;
+        if (heading < 0)
+            heading += 360.0f;
+
+        JsonDocument fusedDoc;
+        fusedDoc["type"] = "FUSED";
+        fusedDoc["username"] = session.username;
+        fusedDoc["deviceId"] = session.deviceId;
+        fusedDoc["lat"] = lat;
+        fusedDoc["lon"] = lon;
+        fusedDoc["ve"] = ve;
+        fusedDoc["vn"] = vn;
+        fusedDoc["speed"] = sqrtf(ve * ve + vn * vn) * 3.6f;
+        fusedDoc["heading"] = heading;
+        fusedDoc["posStd"] = session.fusion.positionStd();
+        fusedDoc["bridgeTs"] = now;
+
+        String fusedMsg;
+        serializeJson(fusedDoc, fusedMsg);
+        broadcast(fusedMsg, "1:FUSED:" + session.deviceId);
+        queueForFlask(fusedDoc);
+        fused++;
+    }
+
+    void dispatchMessage(uint32_t clientId, const String &json)
+    {
+        JsonDocument doc;
+        if (deserializeJson(doc, json.c_str(), json.length()))
+            return;
+
+        MsgType msgType = parseMsgType(doc["type"] | "");
+        UserSession *session = nullptr;
+        auto it = activeSessions.find(clientId);
+        if (it != activeSessions.end() && !it->second.superseded)
+            session = &it->second;
+
+        switch (msgType)
+        {
+        case MsgType::Register:
+            handleRegister(clientId, doc);
+            break;
+        case MsgType::Resume:
+            handleResume(clientId, doc);
+            break;
+        case MsgType::EnableSharing:
+            if (session)
+                session->dataSharingEnabled = doc["enabled"].as<bool>();
+            break;
+        case MsgType::TimePong:
+            if (session)
+                session->clock.addSample(doc["t0"].as<uint32_t>(), doc["t1"].as<int64_t>(), millis());
+            break;
+        case MsgType::Gps:
+        case MsgType::Imu:
+            if (session)
+                handleSensorData(doc, session, msgType);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // WS_EVT_DISCONNECT for a phone socket
+    void socketClosed(uint32_t clientId)
+    {
+        auto it = activeSessions.find(clientId);
+        if (it != activeSessions.end())
+        {
+            it->second.disconnectPending = true;
+            it->second.disconnectTime = millis();
+        }
+    }
+
+    // The session part of loop()
+    void sessionSweep(unsigned long currentTime)
+    {
+        auto it = activeSessions.begin();
+        while (it != activeSessions.end())
+        {
+            UserSession &session = it->second;
+            if (session.superseded)
+            {
+                it = activeSessions.erase(it);
+                continue;
+            }
+
+            if (!session.disconnectPending)
+            {
+                ClockSync &clock = session.clock;
+                unsigned long interval = clock.samples < CLOCK_SYNC_FAST_SAMPLES ? CLOCK_SYNC_FAST_INTERVAL : CLOCK_SYNC_INTERVAL;
+                if (currentTime - clock.lastPing > interval)
+                    sendClockPing(session);
+
+                if (session.dataSharingEnabled && session.fusion.beatsFix() &&
+                    currentTime - session.lastFused >= FUSION_OUTPUT_INTERVAL &&
+                    (int32_t)(currentTime - session.fusion.lastFix) < (int32_t)FUSION_STALE_TIMEOUT)
+                {
+                    session.lastFused = currentTime;
+                    sendFused(session, currentTime);
+                }
+            }
+            else if (!session.offlineAnnounced && currentTime - session.disconnectTime > RESUME_GRACE_PERIOD)
+            {
+                announceDisconnected(session);
+            }
+
+            if (session.disconnectPending && (currentTime - session.disconnectTime > DISCONNECT_TIMEOUT))
+            {
+                if (!session.offlineAnnounced)
+                    announceDisconnected(session);
+                it = activeSessions.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    // SUBSCRIBE from a dashboard that has seen nothing yet
+    String buildSnapshotJson(uint32_t since)
+    {
+        bool full = stateCache.needsFull(since);
+
+        JsonDocument doc;
+        doc["type"] = "SNAPSHOT";
+        doc["version"] = stateCache.version;
+        doc["full"] = full;
+
+        JsonArray devices = doc["devices"].to<JsonArray>();
+        for (auto &entry : stateCache.devices)
+        {
+            const DeviceState &state = entry.second;
+            if (!full && state.version <= since)
+                continue;
+
+            JsonObject device = devices.add<JsonObject>();
+            device["deviceId"] = entry.first;
+            device["username"] = state.username;
+            device["online"] = state.online;
+            device["v"] = state.version;
+            if (state.gps.length())
+                device["gps"] = serialized(state.gps);
+            if (state.imu.length())
+                device["imu"] = serialized(state.imu);
+        }
+
+        String output;
+        serializeJson(doc, output);
+        return output;
+    }
+
+    // One batched POST, as loop() sends it
+    void uplink(uint32_t now)
+    {
+        if (!uplinkQueue.hasWork())
+            return;
+        int e = uplinkPool.pick(now);
+        if (e < 0)
+            return;
+
+        static DeflateLite deflate;
+        const String &batch = uplinkQueue.batch(UPLINK_BATCH_SIZE);
+        bool ok = servers[e];
+        if (ok && batch.length() >= UPLINK_COMPRESS_MIN_BYTES)
+        {
+            uint8_t *compressed = new uint8_t[batch.length()];
+            deflate.compress((const uint8_t *)batch.c_str(), batch.length(), compressed, batch.length());
+            delete[] compressed;
+        }
+        uplinkPool.report(e, ok, ok ? 30 : UPLINK_CONNECT_TIMEOUT, now);
+
+        bool wasDropped;
+        size_t settled = uplinkQueue.settle(ok, UPLINK_MAX_ATTEMPTS, wasDropped);
+        (wasDropped ? dropped : delivered) += settled;
+    }
+
+    // /api/device/<id>/history streamed in small chunks into a response
+    void historyRequest(const String &deviceId)
+    {
+        if (!history.find(deviceId.c_str()))
+            return;
+        HistoryCursor *cursor = new HistoryCursor();
+        cursor->deviceId = deviceId;
+        cursor->since = 0;
+        uint8_t chunk[300];
+        size_t n, total = 0;
+        while ((n = historyFillJson(history, *cursor, chunk, 100 + chance(200))) > 0)
+            total += n;
+        delete cursor;
+        TEST_ASSERT_GREATER_THAN(100, total);
+    }
+
+    // ---- Phone side ----
+
+    // client->text() towards a phone: the app parses every message
+    void toPhone(uint32_t clientId, const char *msg, size_t len)
+    {
+        for (auto &entry : phones)
+        {
+            Phone &phone = entry.second;
+            if (!phone.connected || phone.clientId != clientId)
+                continue;
+
+            JsonDocument reply;
+            TEST_ASSERT_FALSE(deserializeJson(reply, msg, len));
+            const char *type = reply["type"] | "";
+            if (strcmp(type, "REGISTERED") == 0)
+            {
+                phone.resumeToken = reply["resumeToken"].as<String>();
+                phone.needSharing = true;
+            }
+            else if (strcmp(type, "RESUME_FAILED") == 0)
+            {
+                phone.resumeToken = "";
+                phone.needRegister = true;
+            }
+            else if (strcmp(type, "TIME_PING") == 0)
+            {
+                phone.pingT0 = reply["t0"];
+                phone.pongDue = true;
+            }
+        }
+    }
+
+    void send(Phone &phone, const JsonDocument &doc)
+    {
+        String json;
+        serializeJson(doc, json);
+        dispatchMessage(phone.clientId, json);
+    }
+
+    void sendRegister(Phone &phone)
+    {
+        JsonDocument doc;
+        doc["type"] = "REGISTER";
+        doc["username"] = phone.username;
+        doc["deviceId"] = phone.deviceId;
+        send(phone, doc);
+    }
+
+    void connect(unsigned device, uint32_t now)
+    {
+        Phone &phone = phones[device];
+        if (!phone.username.length())
+        {
+            char text[24];
+            snprintf(text, sizeof(text), "user%u", device);
+            phone.username = text;
+            snprintf(text, sizeof(text), "phone-%04u", device);
+            phone.deviceId = text;
+            phone.skew = 1700000000000LL + (int64_t)chance(20000) - 10000;
+        }
+        phone.clientId = nextClientId++;
+        phone.connected = true;
+        phone.leaveAt = now + 300000 + chance(3300000); // 5 to 60 minutes
+        phone.nextGps = now + chance(GPS_MS);
+        phone.nextImu = now + chance(IMU_MS);
+        phone.lat = phone.homeLat = LAT0 + device * 0.001;
+        phone.lon = phone.homeLon = LON0;
+
+        // An app restart loses the token: REGISTER while the old session is still pending
+        if (phone.resumeToken.length() && chance(4) == 0)
+            phone.resumeToken = "";
+
+        if (phone.resumeToken.length())
+        {
+            JsonDocument doc;
+            doc["type"] = "RESUME";
+            doc["deviceId"] = phone.deviceId;
+            doc["token"] = phone.resumeToken;
+            send(phone, doc);
+        }
+        else
+        {
+            phone.needRegister = true;
+        }
+    }
+
+    void sensorFrame(Phone &phone, uint32_t now, bool gps)
+    {
+        JsonDocument doc;
+        doc["type"] = gps ? "GPS" : "IMU";
+        doc["username"] = phone.username;
+        doc["deviceId"] = phone.deviceId;
+        if (gps)
+        {
+            // Wander a few metres around home; the fix scatters by about its accuracy
+            phone.lat += ((int)chance(201) - 100) * 2e-7 - 0.01 * (phone.lat - phone.homeLat);
+            phone.lon += ((int)chance(201) - 100) * 2e-7 - 0.01 * (phone.lon - phone.homeLon);
+            uint32_t accuracy = 3 + chance(20);
+            double scatter = accuracy / 111320.0 / 1000.0;
+            doc["lat"] = phone.lat + scatter * ((int)chance(2001) - 1000);
+            doc["lon"] = phone.lon + scatter * ((int)chance(2001) - 1000);
+            doc["alt"] = 1300 + chance(10);
+            doc["accuracy"] = accuracy;
+            doc["speed"] = chance(50) / 10.0;
+        }
+        else
+        {
+            JsonObject accel = doc["accel"].to<JsonObject>();
+            accel["x"] = chance(100) / 100.0;
+            accel["y"] = chance(100) / 100.0;
+            accel["z"] = 9.81;
+            JsonObject gyro = doc["gyro"].to<JsonObject>();
+            gyro["x"] = 0.01;
+            gyro["y"] = 0.02;
+            gyro["z"] = chance(100) / 100.0;
+        }
+        doc["timestamp"] = (int64_t)now + phone.skew;
+        send(phone, doc);
+    }
+
+    void phoneStep(Phone &phone, uint32_t now)
+    {
+        if (phone.needRegister)
+        {
+            phone.needRegister = false;
+            sendRegister(phone);
+        }
+        if (phone.needSharing)
+        {
+            phone.needSharing = false;
+            JsonDocument doc;
+            doc["type"] = "ENABLE_SHARING";
+            doc["enabled"] = true;
+            send(phone, doc);
+        }
+        if (phone.pongDue)
+        {
+            phone.pongDue = false;
+            JsonDocument doc;
+            doc["type"] = "TIME_PONG";
+            doc["t0"] = phone.pingT0;
+            doc["t1"] = (int64_t)now - 40 + phone.skew;
+            send(phone, doc);
+        }
+        if ((int32_t)(now - phone.nextGps) >= 0)
+        {
+            sensorFrame(phone, now, true);
+            phone.nextGps += GPS_MS;
+        }
+        if ((int32_t)(now - phone.nextImu) >= 0)
+        {
+            sensorFrame(phone, now, false);
+            phone.nextImu += IMU_MS;
+        }
+
+        // Half of the drops come back inside the resume grace period; the rest
+        // may turn up much later, when RESUME fails and they register again
+        if ((int32_t)(now - phone.leaveAt) >= 0)
+        {
+            phone.connected = false;
+            phone.returnAt = chance(2) ? now + 2000 + chance(6000) : 0;
+            socketClosed(phone.clientId);
+        }
+    }
+
+    void step(uint32_t now)
+    {
+        hostMillis() = now;
+
+        // Outages: server 0 down 10 minutes every 3 hours, both down 5 minutes a day
+        uint32_t ofDay = now % DAY_MS;
+        bool bothDown = ofDay >= 43200000 && ofDay < 43500000;
+        servers[0] = !bothDown && now % 10800000 >= 600000;
+        servers[1] = !bothDown;
+
+        size_t connected = 0;
+        for (auto &entry : phones)
+            connected += entry.second.connected;
+        for (auto &entry : phones)
+        {
+            Phone &phone = entry.second;
+            if (!phone.connected && phone.returnAt && (int32_t)(now - phone.returnAt) >= 0)
+            {
+                phone.returnAt = 0;
+                connect(entry.first, now);
+                connected++;
+            }
+        }
+        if (connected < MAX_PHONES && chance(50) == 0)
+        {
+            unsigned device = chance(DEVICE_POOL);
+            if (!phones[device].connected && !phones[device].returnAt)
+                connect(device, now);
+        }
+
+        for (auto &entry : phones)
+        {
+            if (entry.second.connected)
+                phoneStep(entry.second, now);
+        }
+
+        sessionSweep(now);
+        uplink(now);
+
+        // The slow dashboard catches up now and then; dashboards reconnect every few hours
+        if (now % 20000 == 0)
+        {
+            ClientOutbox &slow = outboxes[SLOW_CLIENT];
+            while (!slow.pending.empty())
+                slow.popFront();
+        }
+        if (now % 7200000 == 0)
+        {
+            outboxes.erase(2);
+            outboxes[2] = ClientOutbox();
+        }
+        if (now % 30000 == 0)
+        {
+            String snapshot = buildSnapshotJson(0);
+            TEST_ASSERT_EQUAL(0, strncmp(snapshot.c_str(), "{\"type\":\"SNAPSHOT\"", 18));
+        }
+        if (now % 600000 == 0 && !activeSessions.empty())
+            historyRequest(activeSessions.begin()->second.deviceId);
+    }
+
+    // Run one simulated day; heap figures taken at the end of it
+    DayStats runDay(uint32_t day)
+    {
+        size_t allocationsBefore = arena::allocations;
+        arena::peakBytes = arena::liveBytes;
+        for (uint32_t t = 0; t < DAY_MS; t += LOOP_MS)
+            step(day * DAY_MS + t);
+
+        DayStats stats;
+        stats.allocations = arena::allocations - allocationsBefore;
+        stats.liveBytes = arena::liveBytes;
+        stats.liveBlocks = arena::liveBlocks;
+        stats.peakBytes = arena::peakBytes;
+        stats.fragmentation = arena::fragmentation();
+        stats.largestFree = arena::largestFree();
+        return stats;
+    }
+};
+
+void report(uint32_t day, const DayStats &s)
+{
+    char line[160];
+    snprintf(line, sizeof(line),
+             "day %u: %u allocations, live %u bytes in %u blocks, peak %u, fragmentation %u%%, largest free %u",
+             (unsigned)day + 1, (unsigned)s.allocations, (unsigned)s.liveBytes, (unsigned)s.liveBlocks,
+             (unsigned)s.peakBytes, s.fragmentation, (unsigned)s.largestFree);
+    TEST_MESSAGE(line);
+}
+
+// What "bounded" means for a later day compared with the first settled day:
+// the live set and the daily peak within a few KB, no creeping block count,
+// fragmentation not worsening, allocations per day not creeping up
+bool bounded(const DayStats &base, const DayStats &day)
+{
+    return day.liveBytes <= base.liveBytes + 4096 &&
+           day.liveBlocks <= base.liveBlocks + 32 &&
+           day.peakBytes <= base.peakBytes + base.peakBytes / 8 + 4096 &&
+           day.fragmentation <= base.fragmentation + 10 &&
+           day.allocations <= base.allocations + base.allocations / 10;
+}
+
+// Each test gets a fresh bridge on the counted heap, freed again even when
+// the test fails, so the two runs never share the arena
+std::unique_ptr<Bridge> current;
+
+void setUp()
+{
+    current.reset(new Bridge());
+    current->begin();
+}
+
+void tearDown()
+{
+    current.reset();
+}
+
+void test_heap_stays_flat_over_days()
+{
+    Bridge &bridge = *current;
+
+    DayStats warmup = bridge.runDay(0);
+    report(0, warmup);
+    DayStats base = bridge.runDay(1);
+    report(1, base);
+
+    for (uint32_t day = 2; day < SOAK_DAYS; day++)
+    {
+        DayStats stats = bridge.runDay(day);
+        report(day, stats);
+        TEST_ASSERT_TRUE_MESSAGE(bounded(base, stats), "heap use grew from one day to the next");
+        TEST_ASSERT_LESS_OR_EQUAL(50, stats.fragmentation);
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line), "%u frames, %u records delivered, %u dropped in outages", (unsigned)bridge.frames,
+             (unsigned)bridge.delivered, (unsigned)bridge.dropped);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "%u resumes, %u sessions superseded, %u FUSED, %u fence crossings",
+             (unsigned)bridge.resumes, (unsigned)bridge.supersedes, (unsigned)bridge.fused, (unsigned)bridge.crossings);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_THAN(0, bridge.dropped); // The outages did bite
+    TEST_ASSERT_GREATER_THAN(bridge.dropped * 10, bridge.delivered);
+
+    // Every path that copies a session ran many times over
+    TEST_ASSERT_GREATER_THAN(100, bridge.resumes);
+    TEST_ASSERT_GREATER_THAN(100, bridge.supersedes);
+    TEST_ASSERT_GREATER_THAN(1000, bridge.fused);
+    TEST_ASSERT_GREATER_THAN(1000, bridge.crossings);
+}
+
+// The same check must fail on a slow leak, or it proves nothing
+void test_harness_catches_a_leak()
+{
+    Bridge &bridge = *current;
+    DayStats base = bridge.runDay(0);
+
+    // One small block every 200 frames, about 7 KB an hour here
+    bridge.leakEvery = 200;
+    uint32_t framesBefore = bridge.frames;
+    for (uint32_t t = 0; t < DAY_MS / 12; t += LOOP_MS)
+        bridge.step(DAY_MS + t);
+
+    DayStats leaked = base;
+    leaked.liveBytes = arena::liveBytes;
+    leaked.liveBlocks = arena::liveBlocks;
+    TEST_ASSERT_FALSE(bounded(base, leaked));
+
+    // Every leaked block shows up, give or take the live set's own swing
+    uint32_t leaks = (bridge.frames - framesBefore) / 200;
+    TEST_ASSERT_GREATER_OR_EQUAL(leaks - 32, arena::liveBlocks - base.liveBlocks);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_heap_stays_flat_over_days);
+    RUN_TEST(test_harness_catches_a_leak);
+    return UNITY_END();
+}
@@ -0,0 +1,264 @@
+// Circuit breakers and batch retry of the Flask uplink, against simulated
+// servers that can be killed and revived mid-run
+
+#include <Arduino.h>
+#include <unity.h>
+#include <vector>
+#include "config.h"
+#include "uplink_pool.h"
+#include "uplink_queue.h"
+
+const char *const HOSTS[] = {"10.0.0.1:5000", "10.0.0.2:5000", "10.0.0.3:5000"};
+
+UplinkPool pool;
+
+void setUp()
+{
+    pool.begin(HOSTS, 3);
+}
+
+void tearDown() {}
+
+// Fail `index` until its circuit opens
+void tripBreaker(int index, uint32_t now)
+{
+    for (uint8_t i = 0; i < UPLINK_FAILURE_THRESHOLD; i++)
+        pool.report(index, false, UPLINK_HTTP_TIMEOUT, now);
+}
+
+void test_round_robin_over_healthy_servers()
+{
+    TEST_ASSERT_EQUAL(0, pool.pick(0));
+    TEST_ASSERT_EQUAL(1, pool.pick(0));
+    TEST_ASSERT_EQUAL(2, pool.pick(0));
+    TEST_ASSERT_EQUAL(0, pool.pick(0));
+    TEST_ASSERT_EQUAL(3, pool.healthy());
+}
+
+void test_breaker_opens_after_threshold()
+{
+    for (uint8_t i = 0; i + 1 < UPLINK_FAILURE_THRESHOLD; i++)
+        pool.report(1, false, UPLINK_HTTP_TIMEOUT, 0);
+    TEST_ASSERT_EQUAL(UplinkEndpoint::Closed, pool.endpoint(1).state);
+
+    pool.report(1, false, UPLINK_HTTP_TIMEOUT, 0);
+    TEST_ASSERT_EQUAL(UplinkEndpoint::Open, pool.endpoint(1).state);
+    TEST_ASSERT_EQUAL(UPLINK_BACKOFF_MIN, pool.endpoint(1).backoff);
+    TEST_ASSERT_EQUAL(2, pool.healthy());
+
+    // Skipped until its backoff runs out
+    for (int i = 0; i < 10; i++)
+        TEST_ASSERT_NOT_EQUAL(1, pool.pick(UPLINK_BACKOFF_MIN - 1));
+}
+
+void test_success_resets_failure_count()
+{
+    for (int round = 0; round < 5; round++)
+    {
+        for (uint8_t i = 0; i + 1 < UPLINK_FAILURE_THRESHOLD; i++)
+            pool.report(0, false, UPLINK_HTTP_TIMEOUT, 0);
+        pool.report(0, true, 20, 0);
+    }
+    TEST_ASSERT_EQUAL(UplinkEndpoint::Closed, pool.endpoint(0).state);
+}
+
+void test_probe_failure_doubles_backoff_up_to_max()
+{
+    tripBreaker(0, 0);
+    uint32_t now = 0;
+    uint32_t expected = UPLINK_BACKOFF_MIN;
+    for (int i = 0; i < 10; i++)
+    {
+        TEST_ASSERT_EQUAL(expected, pool.endpoint(0).backoff);
+        now = pool.endpoint(0).retryAt;
+
+        // Due: the probe wins over round-robin
+        TEST_ASSERT_EQUAL(0, pool.pick(now));
+        TEST_ASSERT_EQUAL(UplinkEndpoint::HalfOpen, pool.endpoint(0).state);
+
+        // Only one probe at a time
+        TEST_ASSERT_NOT_EQUAL(0, pool.pick(now));
+
+        pool.report(0, false, UPLINK_HTTP_TIMEOUT, now);
+        TEST_ASSERT_EQUAL(UplinkEndpoint::Open, pool.endpoint(0).state);
+        expected = min(expected * 2, UPLINK_BACKOFF_MAX);
+    }
+    TEST_ASSERT_EQUAL(UPLINK_BACKOFF_MAX, pool.endpoint(0).backoff);
+}
+
+void test_probe_success_closes_circuit()
+{
+    tripBreaker(2, 1000);
+    uint32_t due = pool.endpoint(2).retryAt;
+    TEST_ASSERT_EQUAL(2, pool.pick(due));
+    pool.report(2, true, 25, due);
+
+    TEST_ASSERT_EQUAL(UplinkEndpoint::Closed, pool.endpoint(2).state);
+    TEST_ASSERT_EQUAL(0, pool.endpoint(2).backoff);
+    TEST_ASSERT_EQUAL(3, pool.healthy());
+
+    // Back in the rotation
+    bool picked = false;
+    for (int i = 0; i < 3; i++)
+        picked |= pool.pick(due) == 2;
+    TEST_ASSERT_TRUE(picked);
+}
+
+void test_all_open_holds_batches()
+{
+    for (int i = 0; i < 3; i++)
+        tripBreaker(i, 0);
+    TEST_ASSERT_EQUAL(-1, pool.pick(UPLINK_BACKOFF_MIN - 1));
+    TEST_ASSERT_EQUAL(0, pool.pick(UPLINK_BACKOFF_MIN));
+}
+
+void test_released_probe_is_probed_again()
+{
+    tripBreaker(1, 0);
+    TEST_ASSERT_EQUAL(1, pool.pick(UPLINK_BACKOFF_MIN));
+
+    // Batch never sent (WiFi dropped): nothing learned about the server
+    pool.release(1);
+    TEST_ASSERT_EQUAL(UplinkEndpoint::Open, pool.endpoint(1).state);
+    TEST_ASSERT_EQUAL(UPLINK_BACKOFF_MIN, pool.endpoint(1).backoff);
+    TEST_ASSERT_EQUAL(1, pool.pick(UPLINK_BACKOFF_MIN + 1));
+}
+
+void test_queue_drops_when_full_and_trims_oldest()
+{
+    UplinkQueue queue;
+    for (int i = 0; i < 5; i++)
+        TEST_ASSERT_TRUE(queue.push(String(i), 5));
+    TEST_ASSERT_FALSE(queue.push(String(5), 5));
+    TEST_ASSERT_EQUAL(5, queue.size());
+
+    TEST_ASSERT_EQUAL(3, queue.trim(2));
+    TEST_ASSERT_EQUAL_STRING("[3,4]", queue.batch(8).c_str());
+}
+
+void test_batch_is_retried_then_dropped_after_max_attempts()
+{
+    UplinkQueue queue;
+    for (int i = 0; i < 3; i++)
+        queue.push(String(i), 10);
+
+    bool dropped;
+    String first = queue.batch(2);
+    TEST_ASSERT_EQUAL_STRING("[0,1]", first.c_str());
+    for (uint8_t attempt = 1; attempt < UPLINK_MAX_ATTEMPTS; attempt++)
+    {
+        TEST_ASSERT_EQUAL(0, queue.settle(false, UPLINK_MAX_ATTEMPTS, dropped));
+        TEST_ASSERT_FALSE(dropped);
+        TEST_ASSERT_EQUAL(attempt, queue.attempts());
+        TEST_ASSERT_EQUAL_STRING(first.c_str(), queue.batch(2).c_str()); // Same batch, next server
+    }
+    TEST_ASSERT_EQUAL(2, queue.settle(false, UPLINK_MAX_ATTEMPTS, dropped));
+    TEST_ASSERT_TRUE(dropped);
+
+    TEST_ASSERT_EQUAL_STRING("[2]", queue.batch(2).c_str());
+    TEST_ASSERT_EQUAL(1, queue.settle(true, UPLINK_MAX_ATTEMPTS, dropped));
+    TEST_ASSERT_FALSE(dropped);
+    TEST_ASSERT_FALSE(queue.hasWork());
+}
+
+// What loop() does with the pool and queue, against servers that are up or down
+struct StubServer
+{
+    bool up = true;
+    uint32_t batches = 0;
+    uint32_t refused = 0;
+};
+
+struct Uplink
+{
+    UplinkQueue queue;
+    StubServer servers[3];
+    uint32_t delivered = 0;
+    uint32_t dropped = 0;
+
+    void step(uint32_t now)
+    {
+        if (!queue.hasWork())
+            return;
+        int e = pool.pick(now);
+        if (e < 0)
+            return;
+
+        queue.batch(UPLINK_BATCH_SIZE);
+        StubServer &server = servers[e];
+        bool ok = server.up;
+        (ok ? server.batches : server.refused)++;
+        pool.report(e, ok, ok ? 30 : UPLINK_CONNECT_TIMEOUT, now);
+
+        bool wasDropped;
+        size_t settled = queue.settle(ok, UPLINK_MAX_ATTEMPTS, wasDropped);
+        (wasDropped ? dropped : delivered) += settled;
+    }
+};
+
+void test_server_killed_and_revived_mid_run()
+{
+    Uplink uplink;
+    uint32_t produced = 0;
+    uint32_t refusedWhileDown = 0;
+
+    // 10 minutes in 100 ms loop passes; server 1 is down from 1 to 4 minutes
+    for (uint32_t now = 0; now < 600000; now += 100)
+    {
+        uplink.servers[1].up = now < 60000 || now >= 240000;
+        if (now == 240000)
+            refusedWhileDown = uplink.servers[1].refused;
+
+        if (now % 500 == 0 && uplink.queue.push(String("{\"t\":") + String(now) + "}", 64))
+            produced++;
+        uplink.step(now);
+    }
+    while (uplink.queue.hasWork())
+        uplink.step(600000);
+
+    // Two healthy servers absorb every batch: nothing lost
+    TEST_ASSERT_EQUAL(0, uplink.dropped);
+    TEST_ASSERT_EQUAL(produced, uplink.delivered);
+
+    // The dead server costs the threshold, then one probe per backoff period
+    // (2+4+8+16+32+60+60 s covers the three minutes)
+    TEST_ASSERT_LESS_OR_EQUAL(UPLINK_FAILURE_THRESHOLD + 8, refusedWhileDown);
+
+    // Revived: probed within one max backoff, then back in rotation
+    TEST_ASSERT_EQUAL(UplinkEndpoint::Closed, pool.endpoint(1).state);
+    TEST_ASSERT_GREATER_THAN(100, uplink.servers[1].batches);
+}
+
+void test_all_servers_down_drops_after_max_attempts()
+{
+    Uplink uplink;
+    for (StubServer &server : uplink.servers)
+        server.up = false;
+
+    for (int i = 0; i < 8; i++)
+        uplink.queue.push(String(i), 64);
+    for (uint32_t now = 0; now < 10000; now += 100)
+        uplink.step(now);
+
+    TEST_ASSERT_EQUAL(8, uplink.dropped);
+    TEST_ASSERT_EQUAL(0, uplink.delivered);
+    TEST_ASSERT_EQUAL(UPLINK_MAX_ATTEMPTS, uplink.servers[0].refused + uplink.servers[1].refused +
+                                               uplink.servers[2].refused);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_robin_over_healthy_servers);
+    RUN_TEST(test_breaker_opens_after_threshold);
+    RUN_TEST(test_success_resets_failure_count);
+    RUN_TEST(test_probe_failure_doubles_backoff_up_to_max);
+    RUN_TEST(test_probe_success_closes_circuit);
+    RUN_TEST(test_all_open_holds_batches);
+    RUN_TEST(test_released_probe_is_probed_again);
+    RUN_TEST(test_queue_drops_when_full_and_trims_oldest);
+    RUN_TEST(test_batch_is_retried_then_dropped_after_max_attempts);
+    RUN_TEST(test_server_killed_and_revived_mid_run);
+    RUN_TEST(test_all_servers_down_drops_after_max_attempts);
+    return UNITY_END();
+}